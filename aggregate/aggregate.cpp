@@ -0,0 +1,132 @@
+#include "aggregate.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+p2_quantile::p2_quantile(double quantile) : p{quantile} {}
+
+void p2_quantile::clear() {
+	count = 0;
+}
+
+void p2_quantile::add(double x) {
+	if (count < exact_samples) {
+		first[count++] = x;
+		return;
+	}
+
+	if (count == exact_samples) {
+		// markers at the sorted ranks nearest to where they belong, each on a sample of its own
+		std::sort(first, first + exact_samples);
+		const double fractions[5] = {0, p / 2, p, (1 + p) / 2, 1};
+		double previous = 0;
+		for (int i = 0; i < 5; ++i) {
+			increments[i] = fractions[i];
+			desired[i] = 1 + (exact_samples - 1) * fractions[i];
+			const double highest = exact_samples - (4 - i);
+			positions[i] = std::min(std::max(std::round(desired[i]), previous + 1), highest);
+			heights[i] = first[static_cast<size_t>(positions[i]) - 1];
+			previous = positions[i];
+		}
+	}
+	++count;
+
+	int k;
+	if (x < heights[0]) {
+		heights[0] = x;
+		k = 0;
+	} else if (x >= heights[4]) {
+		heights[4] = x;
+		k = 3;
+	} else {
+		k = static_cast<int>(std::upper_bound(heights + 1, heights + 4, x) - heights) - 1;
+	}
+
+	for (int i = k + 1; i < 5; ++i)
+		++positions[i];
+	for (int i = 0; i < 5; ++i)
+		desired[i] += increments[i];
+
+	for (int i = 1; i < 4; ++i) {
+		const double d = desired[i] - positions[i];
+		if ((d >= 1 && positions[i + 1] - positions[i] > 1) || (d <= -1 && positions[i - 1] - positions[i] < -1)) {
+			const int step = d > 0 ? 1 : -1;
+			const double h = parabolic(i, step);
+			heights[i] = heights[i - 1] < h && h < heights[i + 1] ? h : linear(i, step);
+			positions[i] += step;
+		}
+	}
+}
+
+double p2_quantile::parabolic(int i, int d) const {
+	const double n = positions[i], n_prev = positions[i - 1], n_next = positions[i + 1];
+	return heights[i] + d / (n_next - n_prev) *
+	                        ((n - n_prev + d) * (heights[i + 1] - heights[i]) / (n_next - n) +
+	                         (n_next - n - d) * (heights[i] - heights[i - 1]) / (n - n_prev));
+}
+
+double p2_quantile::linear(int i, int d) const {
+	return heights[i] + d * (heights[i + d] - heights[i]) / (positions[i + d] - positions[i]);
+}
+
+double p2_quantile::get() const {
+	if (!count)
+		return 0;
+	if (count > exact_samples)
+		return heights[2];
+
+	// nearest rank
+	double sorted[exact_samples];
+	std::copy(first, first + count, sorted);
+	const auto rank = std::max<size_t>(static_cast<size_t>(std::ceil(p * count)), 1) - 1;
+	std::nth_element(sorted, sorted + rank, sorted + count);
+	return sorted[rank];
+}
+
+void summary::add(double x) {
+	if (!count++) {
+		min = max = x;
+	} else {
+		min = std::min(min, x);
+		max = std::max(max, x);
+	}
+	const double delta = x - mean;
+	mean += delta / count;
+	m2 += delta * (x - mean);
+}
+
+double summary::stddev() const {
+	return count > 1 ? std::sqrt(m2 / (count - 1)) : 0;
+}
+
+aggregator::field::field(std::string_view k)
+    : key{k},
+      min_key{key + "_min"},
+      max_key{key + "_max"},
+      mean_key{key + "_mean"},
+      std_key{key + "_std"},
+      p95_key{key + "_p95"} {}
+
+void aggregator::add(std::string_view key, double value) {
+	// a handful of fields, a linear search beats hashing
+	auto it = std::find_if(fields.begin(), fields.end(), [key](const field& f) { return f.key == key; });
+	if (it == fields.end())
+		it = fields.emplace(fields.end(), key);
+
+	it->sum.add(value);
+	it->quantile.add(value);
+}
+
+void aggregator::emit(record& rec) {
+	for (auto& f : fields) {
+		if (!f.sum.count)
+			continue;
+		rec.add(f.min_key, f.sum.min);
+		rec.add(f.max_key, f.sum.max);
+		rec.add(f.mean_key, f.sum.mean);
+		rec.add(f.std_key, f.sum.stddev());
+		rec.add(f.p95_key, f.quantile.get());
+		f.sum = {};
+		f.quantile.clear();
+	}
+}
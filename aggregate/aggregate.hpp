@@ -0,0 +1,79 @@
+#pragma once
+
+#include "../record/record.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+
+/*
+ * Streaming quantile estimate by the P² algorithm (Jain & Chlamtac 1985):
+ * five markers moved along a piecewise-parabolic fit. The first samples are
+ * kept for an exact answer in short windows and to place the markers.
+ */
+class p2_quantile {
+ public:
+	explicit p2_quantile(double quantile);
+
+	void add(double);
+
+	// exact up to exact_samples, 0 if empty
+	[[nodiscard]] double get() const;
+
+	void clear();
+
+	static constexpr size_t exact_samples = 32;
+
+ private:
+	double p;
+	uint64_t count = 0;
+	double first[exact_samples];
+	double heights[5];
+	double positions[5];
+	double desired[5];
+	double increments[5];
+
+	[[nodiscard]] double parabolic(int i, int d) const;
+	[[nodiscard]] double linear(int i, int d) const;
+};
+
+// min, max, and mean and variance by Welford's method
+struct summary {
+	uint64_t count = 0;
+	double min = 0;
+	double max = 0;
+	double mean = 0;
+	double m2 = 0;
+
+	void add(double);
+
+	// sample standard deviation, 0 below two samples
+	[[nodiscard]] double stddev() const;
+};
+
+/*
+ * Statistics of every field over a report window. Memory only grows with the
+ * number of distinct fields, never with the number of samples.
+ */
+class aggregator {
+ public:
+	void add(std::string_view key, double value);
+
+	// adds <key>_min, _max, _mean, _std and _p95 of fields sampled since the last emit, then starts a new window
+	void emit(record&);
+
+ private:
+	struct field {
+		explicit field(std::string_view key);
+
+		// record keys point here, deque keeps them in place
+		std::string key;
+		std::string min_key, max_key, mean_key, std_key, p95_key;
+		summary sum;
+		p2_quantile quantile{0.95};
+	};
+
+	std::deque<field> fields;
+};
@@ -0,0 +1,153 @@
+#include "aqi.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <iterator>
+
+namespace {
+struct breakpoint {
+	uint64_t low, high;
+	int64_t index_low, index_high;
+};
+
+// concentrations in tenths of ug/m3, PM2.5 as revised in 2024
+constexpr breakpoint pm25_scale[] = {
+    {0, 90, 0, 50},
+    {91, 354, 51, 100},
+    {355, 554, 101, 150},
+    {555, 1254, 151, 200},
+    {1255, 2254, 201, 300},
+    {2255, 3254, 301, 500},
+};
+
+// PM10 is truncated to whole ug/m3, these are tenths of it anyway
+constexpr breakpoint pm10_scale[] = {
+    {0, 540, 0, 50},
+    {550, 1540, 51, 100},
+    {1550, 2540, 101, 150},
+    {2550, 3540, 151, 200},
+    {3550, 4240, 201, 300},
+    {4250, 6040, 301, 500},
+};
+
+constexpr size_t nowcast_hours = 12;
+// EPA's lower bound of the NowCast weight for particulate matter
+constexpr double min_weight = 0.5;
+};  // namespace
+
+namespace aqi {
+int64_t index(pollutant p, uint64_t deca) {
+	const auto* scale = p == pollutant::pm25 ? std::begin(pm25_scale) : std::begin(pm10_scale);
+	const auto* end = p == pollutant::pm25 ? std::end(pm25_scale) : std::end(pm10_scale);
+	if (p == pollutant::pm10)
+		deca -= deca % 10;
+
+	const auto* b = std::find_if(scale, end, [deca](const breakpoint& b) { return deca <= b.high; });
+	if (b == end)
+		return 500;
+
+	// linear within the category, rounded half up
+	const int64_t span = b->high - b->low;
+	return b->index_low + ((b->index_high - b->index_low) * static_cast<int64_t>(deca - b->low) * 2 + span) / (2 * span);
+}
+
+void hourly::add(uint64_t deca, clock::time_point t) {
+	if (!hour_start)
+		hour_start = t;
+
+	// after a long gap every hour of the day is missing
+	for (size_t gap = 0; t - *hour_start >= std::chrono::hours(1); ++gap) {
+		if (gap == hours) {
+			hour_start = t;
+			break;
+		}
+		close();
+		*hour_start += std::chrono::hours(1);
+	}
+
+	sum += deca;
+	++count;
+}
+
+int64_t hourly::ago(size_t h) const {
+	return averages[(last + hours - 1 - h) % hours];
+}
+
+void hourly::close() {
+	const int64_t average = count ? static_cast<int64_t>((sum * 100 + count / 2) / count) : -1;
+	sum = count = 0;
+
+	if (filled == hours && averages[last] >= 0) {
+		day_sum -= averages[last];
+		--day_count;
+	}
+	averages[last] = average;
+	last = (last + 1) % hours;
+	filled = std::min(filled + 1, hours);
+	if (average >= 0) {
+		day_sum += average;
+		++day_count;
+	}
+
+	now.reset();
+	const size_t recent = std::min(filled, nowcast_hours);
+	size_t known_of_last_three = 0;
+	int64_t low = INT64_MAX, high = 0;
+	for (size_t h = 0; h < recent; ++h) {
+		const auto c = ago(h);
+		if (c < 0)
+			continue;
+		if (h < 3)
+			++known_of_last_three;
+		low = std::min(low, c);
+		high = std::max(high, c);
+	}
+	if (known_of_last_three < 2)
+		return;
+
+	const double weight = high > 0 ? std::max(static_cast<double>(low) / high, min_weight) : 1;
+	double weighted = 0, weights = 0, factor = 1;
+	for (size_t h = 0; h < recent; ++h, factor *= weight) {
+		const auto c = ago(h);
+		if (c < 0)
+			continue;
+		weighted += factor * c;
+		weights += factor;
+	}
+	now = static_cast<uint64_t>(weighted / weights / 100);
+}
+
+std::optional<uint64_t> hourly::nowcast() const {
+	return now;
+}
+
+std::optional<uint64_t> hourly::day() const {
+	if (day_count < hours * 3 / 4)
+		return std::nullopt;
+	return static_cast<uint64_t>(day_sum / static_cast<int64_t>(day_count) / 100);
+}
+
+void monitor::add(const sds011::data& data, clock::time_point t) {
+	pm25.add(data.deca_pm25, t);
+	pm10.add(data.deca_pm10, t);
+}
+
+void monitor::emit(record& rec) const {
+	if (const auto c = pm25.nowcast()) {
+		rec.add("deca_pm25_nowcast", static_cast<int64_t>(*c));
+		rec.add("aqi_pm25_nowcast", index(pollutant::pm25, *c));
+	}
+	if (const auto c = pm25.day()) {
+		rec.add("deca_pm25_24h", static_cast<int64_t>(*c));
+		rec.add("aqi_pm25", index(pollutant::pm25, *c));
+	}
+	if (const auto c = pm10.nowcast()) {
+		rec.add("deca_pm10_nowcast", static_cast<int64_t>(*c));
+		rec.add("aqi_pm10_nowcast", index(pollutant::pm10, *c));
+	}
+	if (const auto c = pm10.day()) {
+		rec.add("deca_pm10_24h", static_cast<int64_t>(*c));
+		rec.add("aqi_pm10", index(pollutant::pm10, *c));
+	}
+}
+};  // namespace aqi
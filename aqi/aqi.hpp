@@ -0,0 +1,71 @@
+#pragma once
+
+#include "../record/record.hpp"
+#include "../sds011/sds011.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+/*
+ * US EPA air quality index of particulate matter, from the 24 hour average
+ * and from the NowCast over the last 12 hours.
+ */
+namespace aqi {
+using clock = std::chrono::steady_clock;
+
+enum class pollutant { pm25, pm10 };
+
+// index of a concentration in tenths of ug/m3, 500 above the scale
+[[nodiscard]] int64_t index(pollutant, uint64_t deca);
+
+/*
+ * Averages of one pollutant per hour for the last day. A sample only adds to
+ * the hour in progress, the day average and the NowCast are only updated when
+ * an hour is over. Hours without samples count as missing.
+ */
+class hourly {
+ public:
+	void add(uint64_t deca, clock::time_point);
+
+	// requires 2 of the last 3 hours
+	[[nodiscard]] std::optional<uint64_t> nowcast() const;
+
+	// requires 18 of the last 24 hours
+	[[nodiscard]] std::optional<uint64_t> day() const;
+
+ private:
+	static constexpr size_t hours = 24;
+
+	// hundredths of deca, so that the day sum stays exact; newest at last - 1, negative when missing
+	std::array<int64_t, hours> averages;
+	size_t last = 0;
+	size_t filled = 0;
+
+	int64_t day_sum = 0;
+	size_t day_count = 0;
+	std::optional<uint64_t> now;
+
+	std::optional<clock::time_point> hour_start;
+	uint64_t sum = 0;
+	uint64_t count = 0;
+
+	void close();
+	[[nodiscard]] int64_t ago(size_t hours) const;
+};
+
+// both pollutants of the SDS011
+class monitor {
+ public:
+	void add(const sds011::data&, clock::time_point);
+
+	// adds deca_pm25_nowcast, aqi_pm25_nowcast, deca_pm25_24h, aqi_pm25 and the same for pm10, as far as known
+	void emit(record&) const;
+
+ private:
+	hourly pm25;
+	hourly pm10;
+};
+};  // namespace aqi
@@ -0,0 +1,390 @@
+// Microbenchmarks of the per-probe hot paths. Prints one JSON object per
+// benchmark and line, so that runs of different commits can be diffed:
+//
+//   {"name":"encode_json","iterations":524288,"ns_per_op":180.2,"min_ns_per_op":176.9}
+//
+// benchmarks that talk to a simulated bus add "transactions_per_op".
+
+#include "../bme280/bme280.hpp"
+#include "../bme280/compensation.hpp"
+#include "../calibration/calibration.hpp"
+#include "../capture/capture.hpp"
+#include "../emu/bme280_chip.hpp"
+#include "../filter/hampel.hpp"
+#include "../history/series.hpp"
+#include "../record/record.hpp"
+#include "../s8/s8.hpp"
+#include "../sds011/sds011.hpp"
+#include "../udp/udpclient.hpp"
+
+#include "../lib/cxxopts.hpp"
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace {
+using steady = std::chrono::steady_clock;
+
+constexpr size_t batches = 7;
+
+template <typename T>
+void keep(const T& value) {
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class runner {
+ public:
+	runner(std::string_view f, std::chrono::milliseconds t) : filter{f}, batch_time{t} {}
+
+	// median and best of several batches, each sized to take about batch_time; extra
+	// appends json members measured by the benchmark itself once it is done
+	template <typename F, typename Extra = std::nullptr_t>
+	void run(std::string_view name, F&& op, const uint64_t* transactions = nullptr, Extra&& extra = nullptr) {
+		if (name.find(filter) == std::string_view::npos)
+			return;
+
+		uint64_t iterations = 1;
+		for (;;) {
+			if (measure(op, iterations) >= batch_time || iterations >= (uint64_t{1} << 32))
+				break;
+			iterations *= 2;
+		}
+
+		const uint64_t transactions_before = transactions ? *transactions : 0;
+		std::vector<double> ns_per_op;
+		for (size_t i = 0; i < batches; ++i)
+			ns_per_op.push_back(std::chrono::duration<double, std::nano>(measure(op, iterations)).count() / iterations);
+		std::sort(ns_per_op.begin(), ns_per_op.end());
+
+		fmt::print("{{\"name\":\"{}\",\"iterations\":{},\"ns_per_op\":{:.1f},\"min_ns_per_op\":{:.1f}", name, iterations, ns_per_op[batches / 2], ns_per_op.front());
+		if (transactions)
+			fmt::print(",\"transactions_per_op\":{:.1f}", double(*transactions - transactions_before) / (batches * iterations));
+		if constexpr (!std::is_same_v<std::decay_t<Extra>, std::nullptr_t>)
+			extra();
+		fmt::print("}}\n");
+		fflush(stdout);
+	}
+
+ private:
+	std::string_view filter;
+	std::chrono::milliseconds batch_time;
+
+	template <typename F>
+	static steady::duration measure(F& op, uint64_t iterations) {
+		const auto started = steady::now();
+		for (uint64_t i = 0; i < iterations; ++i)
+			op();
+		return steady::now() - started;
+	}
+};
+
+record sample_record() {
+	record r;
+	r.name = "bench";
+	r.run = 1700000000;
+	r.seq = 123456;
+	r.add("co2", int64_t{612});
+	r.add("deca_pm25", int64_t{87});
+	r.add("deca_pm10", int64_t{143});
+	r.add("deca_humidity", int64_t{452});
+	r.add("deca_kelvin", int64_t{2951});
+	r.add("gas", 123456.7);
+	return r;
+}
+
+void bench_encode(runner& r) {
+	const auto rec = sample_record();
+	std::string out;
+
+	r.run("encode_json", [&] {
+		out.clear();
+		encode(rec, format::json, out);
+		keep(out.data());
+	});
+
+	r.run("encode_influx", [&] {
+		out.clear();
+		encode(rec, format::influx, out);
+		keep(out.data());
+	});
+}
+
+void bench_sds011(runner& r) {
+	// query reply with PM2.5 8.7 and PM10 14.3
+	uint8_t frame[10] = {0xaa, 0xc0, 0x57, 0x00, 0x8f, 0x00, 0x12, 0x34, 0, 0xab};
+	frame[8] = static_cast<uint8_t>(std::accumulate(&frame[2], &frame[8], 0u));
+
+	r.run("sds011_verify", [&] {
+		sds011::verify(frame);
+		keep(frame);
+	});
+
+	r.run("sds011_decode", [&] {
+		auto data = sds011::decode(frame);
+		keep(data);
+	});
+}
+
+void bench_s8(runner& r) {
+	// reply with 612 ppm, CRC filled in below
+	uint8_t frame[7] = {0xfe, 0x44, 0x02, 0x02, 0x64, 0, 0};
+	const uint16_t crc = s8::crc16(frame, 5);
+	frame[5] = crc & 0xff;
+	frame[6] = crc >> 8;
+
+	r.run("s8_decode", [&] {
+		auto data = s8::decode(frame);
+		keep(data);
+	});
+}
+
+void bench_bme280(runner& r) {
+	using namespace bme280_compensation;
+
+	// calibration and raw readings from the datasheet example
+	const bme280_calib_data cal = {
+	    .dig_T1 = 27504, .dig_T2 = 26435, .dig_T3 = -1000, .dig_P1 = 36477, .dig_P2 = -10685, .dig_P3 = 3024, .dig_P4 = 2855, .dig_P5 = 140, .dig_P6 = -7,
+	    .dig_P7 = 15500, .dig_P8 = -14600, .dig_P9 = 6000, .dig_H1 = 75, .dig_H2 = 362, .dig_H3 = 0, .dig_H4 = 313, .dig_H5 = 50, .dig_H6 = 30,
+	};
+	int32_t adc_t = 519888, adc_p = 415148, adc_h = 30000;
+
+	r.run("bme280_temperature", [&] {
+		keep(adc_t);
+		auto t = deca_celcius(get_temperature_calibration(cal, adc_t));
+		keep(t);
+	});
+
+	r.run("bme280_compensation", [&] {
+		keep(adc_t);
+		const auto t_fine = get_temperature_calibration(cal, adc_t);
+		auto t = deca_celcius(t_fine);
+		auto p = deca_pressure(adc_p, cal, t_fine);
+		auto h = deca_humidity(adc_h, cal, t_fine);
+		keep(t);
+		keep(p);
+		keep(h);
+	});
+}
+
+void bench_bme280_bus(runner& r, std::chrono::nanoseconds latency) {
+	auto chip = std::make_unique<emu::bme280_chip>(latency);
+	const auto& transactions = chip->transactions;
+	bme280 sensor{std::move(chip)};
+
+	r.run(
+	    latency.count() ? fmt::format("bme280_read_{}us_bus", latency.count() / 1000) : "bme280_read",
+	    [&] {
+		    auto data = sensor.get_data();
+		    keep(data);
+	    },
+	    &transactions);
+}
+
+// parsers and encoder on the reply frames of a --record run, corrupt ones included
+void bench_capture(runner& r, const std::string& path) {
+	capture::reader recording{path, false};
+
+	std::vector<std::array<uint8_t, 7>> s8_frames;
+	std::vector<std::array<uint8_t, 10>> sds011_frames;
+	for (const auto& e : recording.entries()) {
+		if (e.what != capture::op::read)
+			continue;
+		const auto* bytes = reinterpret_cast<const uint8_t*>(e.data.data());
+		if (e.data.size() == 7 && bytes[0] == 0xfe && bytes[1] == 0x44)
+			std::copy(bytes, bytes + 7, s8_frames.emplace_back().begin());
+		else if (e.data.size() == 10 && bytes[0] == 0xaa && bytes[1] == 0xc0)
+			std::copy(bytes, bytes + 10, sds011_frames.emplace_back().begin());
+	}
+
+	if (!s8_frames.empty()) {
+		size_t next = 0;
+		r.run("s8_decode_captured", [&] {
+			const auto& frame = s8_frames[next++ % s8_frames.size()];
+			try {
+				auto data = s8::decode(reinterpret_cast<const uint8_t(&)[7]>(*frame.data()));
+				keep(data);
+			} catch (const std::exception&) {
+			}
+		});
+	}
+
+	if (!sds011_frames.empty()) {
+		size_t next = 0;
+		r.run("sds011_decode_captured", [&] {
+			const auto& frame = reinterpret_cast<const uint8_t(&)[10]>(*sds011_frames[next++ % sds011_frames.size()].data());
+			try {
+				sds011::verify(frame);
+				auto data = sds011::decode(frame);
+				keep(data);
+			} catch (const std::exception&) {
+			}
+		});
+
+		record rec;
+		std::string out;
+		r.run("sds011_encode_captured", [&] {
+			const auto& frame = reinterpret_cast<const uint8_t(&)[10]>(*sds011_frames[next++ % sds011_frames.size()].data());
+			rec.clear();
+			rec.name = "bench";
+			try {
+				sds011::verify(frame);
+				const auto data = sds011::decode(frame);
+				rec.add("deca_pm25", static_cast<int64_t>(data.deca_pm25));
+				rec.add("deca_pm10", static_cast<int64_t>(data.deca_pm10));
+			} catch (const std::exception&) {
+			}
+			out.clear();
+			encode(rec, format::json, out);
+			keep(out.data());
+		});
+	}
+}
+
+void bench_hampel(runner& r) {
+	// a slow walk with a spike every 50 samples
+	std::vector<uint64_t> values;
+	for (uint64_t i = 0; i < 1000; ++i)
+		values.push_back(i % 50 ? 80 + i % 7 : 900);
+
+	for (size_t window : {5, 15, 61}) {
+		hampel filter{window, 3};
+		size_t i = 0;
+		r.run(fmt::format("hampel_{}", window), [&] {
+			keep(filter.add(values[i]));
+			i = (i + 1) % values.size();
+		});
+	}
+}
+
+void bench_calibration(runner& r) {
+	std::istringstream config{
+	    "sds011 deca_pm25 offset -3\n"
+	    "sds011 deca_pm25 gain 0.87\n"
+	    "sds011 deca_pm10 curve 0:0 100:95 300:270 1000:850 3000:2400 9999:8000\n"};
+	const auto cal = calibration::parse(config, "bench");
+
+	uint64_t i = 0;
+	r.run("calibrate_sds011", [&] {
+		sds011::data data{.deca_pm25 = 80 + i % 64, .deca_pm10 = 120 + i % 512};
+		cal.apply(data);
+		keep(data);
+		++i;
+	});
+}
+
+void bench_series(runner& r) {
+	// a reading per second with a few ms of jitter, moving slowly
+	series s;
+	int64_t t = 1700000000000;
+	uint64_t i = 0;
+	r.run(
+	    "series_add",
+	    [&] {
+		    t += 1000 + static_cast<int64_t>(i % 7) - 3;
+		    s.add(t, 600 + static_cast<double>(i % 13));
+		    ++i;
+		    // a day at most, as in air
+		    s.expire(t - 86400000);
+	    },
+	    nullptr, [&] { fmt::print(",\"bits_per_point\":{:.1f}", s.bytes() * 8.0 / s.points()); });
+
+	r.run("series_scan_hour", [&] {
+		double sum = 0;
+		s.scan(t - 3600000, t, [&](int64_t, double v) { sum += v; });
+		keep(sum);
+	});
+}
+
+void bench_udp(runner& r) {
+	const int sink = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sink < 0)
+		throw std::runtime_error(fmt::format("Failed to create socket: {}", strerror(errno)));
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t size = sizeof(addr);
+	if (bind(sink, reinterpret_cast<sockaddr*>(&addr), size) < 0 || getsockname(sink, reinterpret_cast<sockaddr*>(&addr), &size) < 0) {
+		close(sink);
+		throw std::runtime_error(fmt::format("Failed to bind: {}", strerror(errno)));
+	}
+
+	std::string payload;
+	encode(sample_record(), format::json, payload);
+
+	udpclient client;
+	client.connect("127.0.0.1", ntohs(addr.sin_port));
+
+	char buffer[2048];
+	r.run("udp_send_loopback", [&] {
+		client.send(payload);
+		// keep the receive queue short, packets beyond it would be dropped silently anyway
+		while (recv(sink, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+		}
+	});
+
+	close(sink);
+}
+};  // namespace
+
+int main(int argc, char** argv) {
+	cxxopts::Options options("air_bench", "Air hot path microbenchmarks");
+
+	std::string filter;
+	uint batch_ms = 20;
+	std::string capture_path;
+
+	options.add_options()
+		("f,filter", "run only benchmarks whose name contains that", cxxopts::value<std::string>(filter))
+		("t,time", "milliseconds per batch", cxxopts::value<uint>(batch_ms))
+		("c,capture", "also run the parsers on the frames of a file written by air --record", cxxopts::value<std::string>(capture_path))
+		("help", "Print help");
+
+	auto result = options.parse(argc, argv);
+
+	if (result.count("help")) {
+		fmt::print("{}\n", options.help({""}));
+		exit(0);
+	}
+
+	runner r{filter, std::chrono::milliseconds(batch_ms)};
+
+	bench_encode(r);
+	bench_sds011(r);
+	bench_s8(r);
+	bench_bme280(r);
+	bench_bme280_bus(r, {});
+	// roughly a byte transaction on a 100 kHz bus
+	bench_bme280_bus(r, std::chrono::microseconds{200});
+	bench_hampel(r);
+	bench_calibration(r);
+	bench_series(r);
+	bench_udp(r);
+
+	if (!capture_path.empty()) {
+		try {
+			bench_capture(r, capture_path);
+		} catch (const std::exception& e) {
+			fmt::print(stderr, "Failed to read capture: {}\n", e.what());
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,360 @@
+// End-to-end benchmark: runs the real air binary against sensors emulated in
+// this process and a loopback UDP receiver. The emulated S8 serves a counter
+// instead of CO2, so every delivered record is matched to the moment its
+// reading left the sensor. Prints one JSON object per scenario and line:
+//
+//   {"sensors":2,"interval_ms":10,"faults":0.01,"records":412,"hz":82.4,"p50_us":620,...}
+//
+// and per sensor count and fault rate the fastest rate air kept up with.
+
+#include "../emu/emulator.hpp"
+#include "../metrics/histogram.hpp"
+
+#include "../lib/cxxopts.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+using steady = std::chrono::steady_clock;
+
+// achieved rate has to be within that of the requested one to count as kept up
+constexpr double sustained = 0.9;
+
+struct scenario {
+	uint sensors;
+	uint interval_ms;
+	double faults;
+};
+
+struct outcome {
+	uint64_t records = 0;
+	double hz = 0;
+	histogram latency;
+	double cpu_us_per_record = 0;
+	uint64_t rss_kb = 0;
+	uint64_t peak_rss_kb = 0;
+};
+
+struct settings {
+	std::string air;
+	std::chrono::milliseconds duration;
+	std::chrono::milliseconds warmup;
+	std::chrono::milliseconds latency;
+	std::chrono::milliseconds jitter;
+};
+
+// user plus system time of the process, in nanoseconds where the kernel has schedstat
+std::chrono::microseconds cpu_time(pid_t pid) {
+	if (std::ifstream schedstat{fmt::format("/proc/{}/schedstat", pid)}) {
+		uint64_t ns;
+		if (schedstat >> ns)
+			return std::chrono::microseconds{ns / 1000};
+	}
+
+	std::ifstream stream{fmt::format("/proc/{}/stat", pid)};
+	std::string line;
+	std::getline(stream, line);
+
+	// the command may contain spaces, fields are counted after its closing parenthesis
+	std::istringstream fields{line.substr(line.rfind(')') + 2)};
+	std::string field;
+	uint64_t utime = 0, stime = 0;
+	for (int i = 3; fields >> field; ++i) {
+		if (i == 14)
+			utime = std::stoull(field);
+		else if (i == 15)
+			stime = std::stoull(field);
+	}
+	return std::chrono::microseconds{(utime + stime) * 1000000 / sysconf(_SC_CLK_TCK)};
+}
+
+uint64_t status_kb(pid_t pid, std::string_view key) {
+	std::ifstream stream{fmt::format("/proc/{}/status", pid)};
+	for (std::string line; std::getline(stream, line);)
+		if (line.compare(0, key.size(), key) == 0)
+			return std::stoull(line.substr(key.size() + 1));
+	return 0;
+}
+
+class receiver {
+ public:
+	receiver() : fh{socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0)} {
+		if (fh < 0)
+			throw std::runtime_error(fmt::format("Failed to create socket: {}", strerror(errno)));
+
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t size = sizeof(addr);
+		if (bind(fh, reinterpret_cast<sockaddr*>(&addr), size) < 0 || getsockname(fh, reinterpret_cast<sockaddr*>(&addr), &size) < 0) {
+			close(fh);
+			throw std::runtime_error(fmt::format("Failed to bind: {}", strerror(errno)));
+		}
+		port = ntohs(addr.sin_port);
+	}
+
+	receiver(const receiver&) = delete;
+
+	~receiver() {
+		close(fh);
+	}
+
+	int fh;
+	ushort port;
+};
+
+// child running air with stdout and stderr discarded, terminated on destruction
+class process {
+ public:
+	explicit process(const std::vector<std::string>& args) : pid{fork()} {
+		if (pid < 0)
+			throw std::runtime_error(fmt::format("Failed to fork: {}", strerror(errno)));
+
+		if (pid == 0) {
+			const int null = open("/dev/null", O_WRONLY);
+			dup2(null, STDOUT_FILENO);
+			dup2(null, STDERR_FILENO);
+
+			std::vector<char*> argv;
+			for (const auto& arg : args)
+				argv.push_back(const_cast<char*>(arg.c_str()));
+			argv.push_back(nullptr);
+			execv(argv[0], argv.data());
+			_exit(127);
+		}
+	}
+
+	process(const process&) = delete;
+
+	~process() {
+		kill(pid, SIGTERM);
+		int status;
+		waitpid(pid, &status, 0);
+	}
+
+	pid_t pid;
+};
+
+outcome run(const settings& s, const scenario& sc, const std::string& dir) {
+	const emu::faults fault{
+	    .latency = s.latency,
+	    .jitter = s.jitter,
+	    .corrupt = sc.faults,
+	    .disconnect = sc.faults / 10,
+	    .reconnect = std::chrono::milliseconds{200},
+	};
+
+	const auto s8_path = dir + "/s8";
+	const auto sds011_path = dir + "/sds011";
+	const auto bme680_path = dir + "/bme680";
+
+	std::vector<std::unique_ptr<emu::device>> devices;
+	auto co2 = std::make_unique<emu::serial>(emu::serial::protocol::s8, s8_path, fault, 1);
+	auto& counter = *co2;
+	devices.push_back(std::move(co2));
+	if (sc.sensors > 1)
+		devices.push_back(std::make_unique<emu::serial>(emu::serial::protocol::sds011, sds011_path, fault, 2));
+	if (sc.sensors > 2)
+		devices.push_back(std::make_unique<emu::climate>(bme680_path, std::chrono::milliseconds{std::max(sc.interval_ms, 1u)}, fault, 3));
+
+	// when each counter value left the sensor
+	std::vector<steady::time_point> served(1 << 16);
+	counter.walk = false;
+	counter.co2 = 1;
+	counter.served = [&](steady::time_point when) {
+		served[counter.co2] = when;
+		counter.co2 = counter.co2 % 0xffff + 1;
+	};
+
+	receiver sink;
+
+	process air{{
+	    s.air,
+	    "--json",
+	    "--name",
+	    "e2e",
+	    "--host",
+	    "127.0.0.1",
+	    "--port",
+	    std::to_string(sink.port),
+	    "--interval-ms",
+	    std::to_string(sc.interval_ms),
+	    "--s8-path",
+	    s8_path,
+	    "--sds011-path",
+	    sc.sensors > 1 ? sds011_path : "",
+	    "--bme680-path",
+	    sc.sensors > 2 ? bme680_path : "",
+	}};
+
+	outcome result;
+	const auto started = steady::now();
+	const auto measured = started + s.warmup;
+	const auto finished = measured + s.duration;
+	bool measuring = false;
+	std::chrono::microseconds cpu_before{0};
+
+	std::vector<pollfd> fds(devices.size() + 1);
+	for (auto now = steady::now(); now < finished; now = steady::now()) {
+		if (!measuring && now >= measured) {
+			measuring = true;
+			cpu_before = cpu_time(air.pid);
+		}
+
+		auto wake = std::min(finished, measuring ? finished : measured);
+		for (size_t i = 0; i < devices.size(); ++i) {
+			fds[i] = {.fd = devices[i]->fd(), .events = POLLIN, .revents = 0};
+			if (const auto deadline = devices[i]->deadline())
+				wake = std::min(wake, *deadline);
+		}
+		fds.back() = {.fd = sink.fh, .events = POLLIN, .revents = 0};
+
+		const auto timeout = std::chrono::ceil<std::chrono::milliseconds>(std::max(wake - now, steady::duration::zero()));
+		if (poll(fds.data(), fds.size(), static_cast<int>(timeout.count())) < 0 && errno != EINTR)
+			throw std::runtime_error(fmt::format("Failed to poll: {}", strerror(errno)));
+
+		now = steady::now();
+		for (size_t i = 0; i < devices.size(); ++i)
+			devices[i]->step(now, fds[i].revents & POLLIN);
+
+		char buffer[2048];
+		for (ssize_t bytes; (bytes = recv(sink.fh, buffer, sizeof(buffer) - 1, 0)) > 0;) {
+			const auto delivered = steady::now();
+			if (!measuring)
+				continue;
+			++result.records;
+
+			buffer[bytes] = 0;
+			if (const char* field = strstr(buffer, "\"co2\":")) {
+				const auto value = strtoul(field + 6, nullptr, 10);
+				if (value && value < served.size() && served[value] != steady::time_point{})
+					result.latency.record(delivered - served[value]);
+			}
+		}
+	}
+
+	const auto cpu = cpu_time(air.pid) - cpu_before;
+	result.hz = result.records / std::chrono::duration<double>(s.duration).count();
+	result.cpu_us_per_record = result.records ? double(cpu.count()) / result.records : 0;
+	result.rss_kb = status_kb(air.pid, "VmRSS:");
+	result.peak_rss_kb = status_kb(air.pid, "VmHWM:");
+	return result;
+}
+
+std::string default_air() {
+	char exe[4096];
+	const auto size = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+	if (size <= 0)
+		return "air";
+	const std::string self{exe, static_cast<size_t>(size)};
+	return self.substr(0, self.rfind('/') + 1) + "air";
+}
+};  // namespace
+
+int main(int argc, char** argv) {
+	cxxopts::Options options("air_e2e_bench", "Air end-to-end latency and throughput against emulated sensors");
+
+	std::string air = default_air();
+	// cxxopts appends to vectors, defaults are filled in after parsing
+	std::vector<uint> sensor_counts;
+	std::vector<uint> intervals;
+	std::vector<double> fault_rates;
+	uint duration_ms = 5000;
+	uint warmup_ms = 500;
+	uint latency_ms = 0;
+	uint jitter_ms = 0;
+
+	options.add_options()
+		("air", "air binary to run", cxxopts::value<std::string>(air))
+		("sensors", "numbers of sensors to emulate, 1 is the S8, 2 adds the SDS011 and 3 the bme680, default 1,2,3", cxxopts::value<std::vector<uint>>(sensor_counts))
+		("intervals", "probe intervals in milliseconds, default 100,10,1", cxxopts::value<std::vector<uint>>(intervals))
+		("faults", "probabilities of a corrupt reply, a tenth of that hangs up instead, default 0,0.01", cxxopts::value<std::vector<double>>(fault_rates))
+		("duration", "milliseconds measured per scenario", cxxopts::value<uint>(duration_ms))
+		("warmup", "milliseconds per scenario before measuring", cxxopts::value<uint>(warmup_ms))
+		("latency", "milliseconds the sensors take to reply", cxxopts::value<uint>(latency_ms))
+		("jitter", "up to that many milliseconds added to latency", cxxopts::value<uint>(jitter_ms))
+		("help", "Print help");
+
+	auto result = options.parse(argc, argv);
+
+	if (result.count("help")) {
+		fmt::print("{}\n", options.help({""}));
+		exit(0);
+	}
+
+	if (sensor_counts.empty())
+		sensor_counts = {1, 2, 3};
+	if (intervals.empty())
+		intervals = {100, 10, 1};
+	if (fault_rates.empty())
+		fault_rates = {0, 0.01};
+
+	const settings s{
+	    .air = air,
+	    .duration = std::chrono::milliseconds{duration_ms},
+	    .warmup = std::chrono::milliseconds{warmup_ms},
+	    .latency = std::chrono::milliseconds{latency_ms},
+	    .jitter = std::chrono::milliseconds{jitter_ms},
+	};
+
+	char dir[] = "/tmp/air_e2e.XXXXXX";
+	if (!mkdtemp(dir)) {
+		fmt::print(stderr, "Failed to create a directory for the devices: {}\n", strerror(errno));
+		return 1;
+	}
+
+	// a killed child must not take the harness with it
+	signal(SIGPIPE, SIG_IGN);
+
+	int status = 0;
+	for (const auto sensors : sensor_counts) {
+		for (const auto faults : fault_rates) {
+			double best_hz = 0;
+			uint best_interval = 0;
+			for (const auto interval : intervals) {
+				const scenario sc{.sensors = std::clamp(sensors, 1u, 3u), .interval_ms = interval, .faults = faults};
+				try {
+					const auto r = run(s, sc, dir);
+					fmt::print(
+					    "{{\"sensors\":{},\"interval_ms\":{},\"faults\":{},\"records\":{},\"hz\":{:.1f},\"p50_us\":{},\"p99_us\":{},\"p999_us\":{},\"max_us\":{},"
+					    "\"cpu_us_per_record\":{:.1f},\"rss_kb\":{},\"peak_rss_kb\":{}}}\n",
+					    sc.sensors, sc.interval_ms, sc.faults, r.records, r.hz, r.latency.quantile_us(0.5), r.latency.quantile_us(0.99), r.latency.quantile_us(0.999),
+					    r.latency.max_us(), r.cpu_us_per_record, r.rss_kb, r.peak_rss_kb);
+					fflush(stdout);
+
+					if (interval && r.hz >= sustained * 1000 / interval && r.hz > best_hz) {
+						best_hz = r.hz;
+						best_interval = interval;
+					}
+				} catch (const std::exception& e) {
+					fmt::print(stderr, "Scenario failed: {}\n", e.what());
+					status = 1;
+				}
+			}
+			fmt::print("{{\"sensors\":{},\"faults\":{},\"max_sustained_hz\":{:.1f},\"at_interval_ms\":{}}}\n", std::clamp(sensors, 1u, 3u), faults, best_hz, best_interval);
+			fflush(stdout);
+		}
+	}
+
+	rmdir(dir);
+	return status;
+}
@@ -1,13 +1,20 @@
 #pragma once
 
+#include "../i2c/i2c.hpp"
+#include "compensation.hpp"
+
 #include <cstdint>
+#include <memory>
+#include <string>
 
 class bme280 {
  public:
-	explicit bme280();
-	explicit bme280(bme280&&);
+	static constexpr const char* default_path = "/dev/i2c-1";
+	static constexpr uint8_t address = 0x76;
 
-	~bme280();
+	explicit bme280(const std::string& path = default_path);
+	// e.g. a simulated chip
+	explicit bme280(std::unique_ptr<i2c::bus>);
 
 	void print_data();
 
@@ -19,5 +26,6 @@ class bme280 {
 	[[nodiscard]] data get_data();
 
  private:
-	int fd;
+	std::unique_ptr<i2c::bus> bus;
+	bme280_compensation::bme280_calib_data cal;
 };
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "compensation.hpp"
+
+namespace bme280_compensation {
+
+int32_t get_temperature_calibration(const bme280_calib_data& cal, int32_t adc_t) {
+	int32_t var1 = ((((adc_t >> 3) - (cal.dig_T1 << 1))) * cal.dig_T2) >> 11;
+
+	int32_t var2 = (((((adc_t >> 4) - cal.dig_T1) * ((adc_t >> 4) - cal.dig_T1)) >> 12) * cal.dig_T3) >> 14;
+
+	return var1 + var2;
+}
+
+float deca_celcius(int32_t t_fine) {
+	float t = (t_fine * 5 + 128) >> 8;
+	return t / 10;
+}
+
+float deca_pressure(int32_t adc_P, const bme280_calib_data& cal, int32_t t_fine) {
+	int64_t var1 = t_fine, var2, p;
+
+	var1 -= 128000;
+	var2 = var1 * var1 * cal.dig_P6;
+	var2 = var2 + ((var1 * cal.dig_P5) << 17);
+	var2 = var2 + ((cal.dig_P4) << 35);
+	var1 = ((var1 * var1 * cal.dig_P3) >> 8) + ((var1 * cal.dig_P2) << 12);
+	var1 = (((1ll << 47) + var1)) * (cal.dig_P1) >> 33;
+
+	if (var1 == 0) {
+		return 0;  // avoid exception caused by division by zero
+	}
+	p = 1048576 - adc_P;
+	p = (((p << 31) - var2) * 3125) / var1;
+	var1 = (cal.dig_P9 * (p >> 13) * (p >> 13)) >> 25;
+	var2 = (cal.dig_P8 * p) >> 19;
+
+	p = ((p + var1 + var2) >> 8) + (cal.dig_P7 << 4);
+	return p / 2560.0;
+}
+
+float deca_humidity(int32_t adc_H, const bme280_calib_data& cal, int32_t t_fine) {
+	int32_t v_x1_u32r = t_fine - 76800;
+
+	v_x1_u32r =
+	    (((((adc_H << 14) - (cal.dig_H4 << 20) - (cal.dig_H5 * v_x1_u32r)) + 16384) >> 15) *
+	     (((((((v_x1_u32r * cal.dig_H6) >> 10) * (((v_x1_u32r * cal.dig_H3) >> 11) + 32768)) >> 10) + 2097152) * cal.dig_H2 + 8192) >> 14));
+
+	v_x1_u32r = (v_x1_u32r - (((((v_x1_u32r >> 15) * (v_x1_u32r >> 15)) >> 7) * cal.dig_H1) >> 4));
+
+	v_x1_u32r = (v_x1_u32r < 0) ? 0 : v_x1_u32r;
+	v_x1_u32r = (v_x1_u32r > 419430400) ? 419430400 : v_x1_u32r;
+	float h = (v_x1_u32r >> 12);
+	return h / 102.4;
+}
+
+};  // namespace bme280_compensation
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * Integer compensation formulas from the BME280 datasheet, section 4.2.3,
+ * separate from the bus code so they can run without the device.
+ */
+namespace bme280_compensation {
+
+struct bme280_calib_data {
+	int32_t dig_T1;
+	int32_t dig_T2;
+	int32_t dig_T3;
+
+	uint16_t dig_P1;
+	int64_t dig_P2;
+	int64_t dig_P3;
+	int64_t dig_P4;
+	int64_t dig_P5;
+	int64_t dig_P6;
+	int64_t dig_P7;
+	int64_t dig_P8;
+	int64_t dig_P9;
+
+	int32_t dig_H1;
+	int32_t dig_H2;
+	int32_t dig_H3;
+	int32_t dig_H4;
+	int32_t dig_H5;
+	int32_t dig_H6;
+};
+
+int32_t get_temperature_calibration(const bme280_calib_data& cal, int32_t adc_t);
+
+float deca_celcius(int32_t t_fine);
+
+float deca_pressure(int32_t adc_P, const bme280_calib_data& cal, int32_t t_fine);
+
+float deca_humidity(int32_t adc_H, const bme280_calib_data& cal, int32_t t_fine);
+
+};  // namespace bme280_compensation
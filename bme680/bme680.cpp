@@ -1,16 +1,25 @@
 #include "bme680.hpp"
+#include "../perf/perf.hpp"
 
 #include <unistd.h>
 #include <cstdlib>
 #include <signal.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 
 #include <fmt/core.h>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <stdexcept>
+#include <string>
 
 namespace {
 
+constexpr double deca_kelvin_zero = 2731.5;
+
 constexpr std::string_view sorry = R"(
 import bme680
 import time
@@ -44,7 +53,10 @@ while True:
 
 };  // namespace
 
-bme680::bme680() {
+bme680::bme680(const std::string& p, bool fetcher) : path{p}, pid{0} {
+	if (!fetcher)
+		return;
+
 	{
 		std::ofstream ostr("/tmp/bme680_fecher.py");
 		ostr << sorry << std::endl;
@@ -62,20 +74,48 @@ bme680::bme680() {
 }
 
 bme680::~bme680() {
-	kill(pid, SIGTERM);
-	int status;
-	waitpid(pid, &status, 0);
+	if (pid > 0) {
+		kill(pid, SIGTERM);
+		int status;
+		waitpid(pid, &status, 0);
+	}
 }
 
 void bme680::print_data() {
 	auto data = this->get_data();
 
-	fmt::print("{}", data.data);
+	fmt::print("Temp: {}℃\n", (data.deca_kelvin - deca_kelvin_zero) / 10.0);
+	fmt::print("Humi: {}%\n", data.deca_humidity / 10.0);
+	if (data.gas)
+		fmt::print("Gas: {} Ohm\n", *data.gas);
 }
 
 bme680::data bme680::get_data() {
-	std::ifstream stream{"/tmp/bme680"};
+	FILE* file = fopen(path.c_str(), "r");
+	if (!file)
+		throw std::runtime_error(fmt::format("Failed to open '{}': {}", path, strerror(errno)));
+
+	// the fetcher replaces the file with every reading, so it was taken when the file was written
+	struct stat st;
+	const bool stated = fstat(fileno(file), &st) == 0;
+	char buffer[256];
+	const std::string line = fgets(buffer, sizeof(buffer), file) ? buffer : "";
+	fclose(file);
+
+	perf::region region{perf::stage::parse};
 	bme680::data data;
-	std::getline(stream, data.data);
-	return data;
+	if (stated)
+		data.written = std::chrono::system_clock::time_point{std::chrono::duration_cast<std::chrono::system_clock::duration>(
+		    std::chrono::seconds{st.st_mtim.tv_sec} + std::chrono::nanoseconds{st.st_mtim.tv_nsec})};
+	double gas;
+	// format is fixed by the fetcher script above
+	switch (sscanf(line.c_str(), "\"deca_humidity\":%" SCNu64 ",\"deca_kelvin\":%" SCNu64 ",\"gas\":%lf", &data.deca_humidity, &data.deca_kelvin, &gas)) {
+		case 3:
+			data.gas = gas;
+			[[fallthrough]];
+		case 2:
+			return data;
+		default:
+			throw std::runtime_error(fmt::format("Can't parse bme680 data '{}'", line));
+	}
 }
\ No newline at end of file
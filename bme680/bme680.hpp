@@ -1,11 +1,16 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
+#include <optional>
 #include <string>
 
 class bme680 {
  public:
-	explicit bme680();
+	static constexpr const char* default_path = "/tmp/bme680";
+
+	// the fetcher writes default_path, without it the file has to be kept up to date by someone else
+	explicit bme680(const std::string& path = default_path, bool fetcher = true);
 	explicit bme680(bme680&&);
 
 	~bme680();
@@ -13,11 +18,16 @@ class bme680 {
 	void print_data();
 
 	struct data {
-		std::string data;
+		uint64_t deca_humidity;
+		uint64_t deca_kelvin;
+		std::optional<double> gas;
+		// when the fetcher wrote it
+		std::optional<std::chrono::system_clock::time_point> written;
 	};
 
 	[[nodiscard]] data get_data();
 
  private:
+	std::string path;
 	int pid;
 };
\ No newline at end of file
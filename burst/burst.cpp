@@ -0,0 +1,139 @@
+#include "burst.hpp"
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+#include <stdexcept>
+#include <variant>
+
+namespace {
+double as_double(const record::value& v) {
+	return std::visit([](auto x) { return static_cast<double>(x); }, v);
+}
+};  // namespace
+
+burst::trigger burst::trigger::parse(std::string_view spec) {
+	const auto op = spec.find_first_of(">+");
+	if (op == std::string_view::npos || !op)
+		throw std::runtime_error(fmt::format("Trigger '{}' should be key>N or key+N", spec));
+
+	const auto number = spec.substr(op + 1);
+	double threshold{};
+	if (auto [end, ec] = std::from_chars(number.data(), number.data() + number.size(), threshold); ec != std::errc{} || end != number.data() + number.size())
+		throw std::runtime_error(fmt::format("Failed to parse threshold of trigger '{}'", spec));
+
+	trigger result{.spec = std::string{spec}, .escaped = {}, .key = std::string{spec.substr(0, op)}};
+	escape_json(spec, result.escaped);
+	if (spec[op] == '>')
+		result.above = threshold;
+	else
+		result.rise = threshold;
+	return result;
+}
+
+burst::burst(std::vector<trigger> t, size_t b, size_t a) : triggers{std::move(t)}, active(triggers.size()), before{b}, after{a}, ring(b + a + 1) {
+	if (triggers.empty())
+		throw std::runtime_error("Burst needs a trigger");
+}
+
+const burst::trigger* burst::check(const record& probe) {
+	const auto& oldest = ring[filled == ring.size() ? next : 0];
+	const trigger* result = nullptr;
+
+	for (size_t i = 0; i < triggers.size(); ++i) {
+		const auto& t = triggers[i];
+		const auto* current = probe.find(t.key);
+		bool now = false;
+		if (current && t.above) {
+			now = as_double(current->val) > *t.above;
+		} else if (current && t.rise && filled) {
+			auto it = std::find_if(oldest.fields.begin(), oldest.fields.end(), [&](const auto& f) { return f.key == t.key; });
+			now = it != oldest.fields.end() && as_double(current->val) - as_double(it->val) >= *t.rise;
+		}
+
+		if (now && !active[i] && !result)
+			result = &t;
+		active[i] = now;
+	}
+	return result;
+}
+
+bool burst::add(const record& probe, clock::time_point at) {
+	if (!remaining) {
+		if ((fired = check(probe))) {
+			fired_at = at;
+			fired_realtime = std::chrono::system_clock::now();
+			remaining = after + 1;
+		}
+	}
+
+	// reuses the vectors of the slot, no allocation once the ring went round
+	auto& slot = ring[next];
+	slot.at = at;
+	slot.fields.assign(probe.fields.begin(), probe.fields.end());
+	next = (next + 1) % ring.size();
+	filled = std::min(filled + 1, ring.size());
+
+	if (!remaining || --remaining)
+		return false;
+
+	collect();
+	return true;
+}
+
+void burst::collect() {
+	const size_t count = std::min(filled, before + after + 1);
+	auto it = std::back_inserter(samples);
+
+	samples.clear();
+	ends.clear();
+	for (size_t i = 0; i < count; ++i) {
+		const auto& s = ring[(next + ring.size() - count + i) % ring.size()];
+		fmt::format_to(it, "{{\"ms\":{}", std::chrono::duration_cast<std::chrono::milliseconds>(s.at - fired_at).count());
+		for (const auto& f : s.fields)
+			std::visit([&](auto v) { fmt::format_to(it, ",\"{}\":{}", f.key, v); }, f.val);
+		samples += '}';
+		ends.push_back(samples.size());
+	}
+
+	// room for the name, run, seq, burst_samples and the burst header
+	const size_t overhead = 160 + fired->escaped.size();
+	const size_t budget = part_bytes > overhead ? part_bytes - overhead : 0;
+	parts.assign(1, 0);
+	for (size_t i = 1; i < count; ++i) {
+		const size_t first = parts.back();
+		// samples and the commas between them
+		if (ends[i] - (first ? ends[first - 1] : 0) + i - first > budget)
+			parts.push_back(i);
+	}
+	parts.push_back(count);
+	part = 0;
+}
+
+bool burst::collecting() const {
+	return remaining > 0;
+}
+
+bool burst::take(record& out) {
+	if (part + 1 >= parts.size())
+		return false;
+
+	const size_t first = parts[part], last = parts[part + 1];
+	auto it = std::back_inserter(out.json_extra);
+
+	fmt::format_to(it, "\"burst\":{{\"trigger\":\"{}\",\"at\":{},\"part\":{},\"parts\":{},\"samples\":[", fired->escaped,
+	               std::chrono::duration_cast<std::chrono::milliseconds>(fired_realtime.time_since_epoch()).count(), part, parts.size() - 1);
+	for (size_t i = first; i < last; ++i) {
+		const size_t begin = i ? ends[i - 1] : 0;
+		if (i > first)
+			out.json_extra += ',';
+		out.json_extra.append(samples, begin, ends[i] - begin);
+	}
+	out.json_extra += "]}";
+
+	// influx has no place for the samples, the count at least marks the burst there
+	out.add("burst_samples", static_cast<int64_t>(last - first));
+	++part;
+	return true;
+}
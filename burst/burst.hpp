@@ -0,0 +1,84 @@
+#pragma once
+
+#include "../record/record.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Keeps the last probes in a ring. When a trigger fires, the probes before it
+ * and a number of probes after it are handed out together, as records whose
+ * json carries them all, split into parts that each fit into a datagram:
+ *
+ *   "burst":{"trigger":"co2>1500","at":<unix ms>,"part":0,"parts":3,"samples":[{"ms":-2000,"co2":1210},..]}
+ *
+ * A trigger only fires when its condition becomes true, not for as long as
+ * it stays true, and not while a burst is being collected.
+ */
+class burst {
+ public:
+	using clock = std::chrono::steady_clock;
+
+	struct trigger {
+		std::string spec;
+		// spec escaped once for the json of every burst
+		std::string escaped;
+		std::string key;
+		// key>N, above N
+		std::optional<double> above = std::nullopt;
+		// key+N, at least N more than the oldest probe in the ring
+		std::optional<double> rise = std::nullopt;
+
+		static trigger parse(std::string_view);
+	};
+
+	burst(std::vector<trigger>, size_t before, size_t after);
+
+	// true when a burst is complete, its parts are then handed out by take
+	[[nodiscard]] bool add(const record& probe, clock::time_point);
+
+	// false once every part of the burst went out
+	[[nodiscard]] bool take(record& out);
+
+	// a trigger fired and probes after it are still missing
+	[[nodiscard]] bool collecting() const;
+
+	// samples of a part, with the rest of the record, stay below an Ethernet MTU; a larger sample goes alone
+	static constexpr size_t part_bytes = 1200;
+
+ private:
+	struct sample {
+		clock::time_point at;
+		// keys of probes are string literals
+		std::vector<record::field> fields;
+	};
+
+	std::vector<trigger> triggers;
+	std::vector<bool> active;
+	size_t before;
+	size_t after;
+
+	// before + after probes, oldest at next once full
+	std::vector<sample> ring;
+	size_t next = 0;
+	size_t filled = 0;
+
+	const trigger* fired = nullptr;
+	clock::time_point fired_at;
+	std::chrono::system_clock::time_point fired_realtime;
+	size_t remaining = 0;
+
+	// json of every sample of a complete burst, and where each of them ends
+	std::string samples;
+	std::vector<size_t> ends;
+	// first sample of every part, then the end
+	std::vector<size_t> parts;
+	size_t part = 0;
+
+	[[nodiscard]] const trigger* check(const record&);
+	void collect();
+};
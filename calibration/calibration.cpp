@@ -0,0 +1,167 @@
+#include "calibration.hpp"
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+constexpr int fraction_bits = 16;
+
+struct slot_name {
+	std::string_view sensor;
+	std::string_view field;
+};
+
+// in the order of calibration::slot
+constexpr slot_name slot_names[] = {
+    {"s8", "co2"},
+    {"sds011", "deca_pm25"},
+    {"sds011", "deca_pm10"},
+    {"bme280", "deca_humidity"},
+    {"bme280", "deca_kelvin"},
+    {"bme680", "deca_humidity"},
+    {"bme680", "deca_kelvin"},
+};
+
+template <typename T>
+T parse_number(std::string_view str, std::string_view what) {
+	T result{};
+	if (auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), result); ec != std::errc{} || end != str.data() + str.size())
+		throw std::runtime_error(fmt::format("Failed to parse {} '{}'", what, str));
+	return result;
+}
+
+int64_t fixed(double value) {
+	return std::llround(std::ldexp(value, fraction_bits));
+}
+
+// rounded to nearest, also for negative products
+int64_t scale(int64_t value, int64_t factor) {
+	const int64_t product = value * factor;
+	return (product + (int64_t{1} << (fraction_bits - 1))) >> fraction_bits;
+}
+};  // namespace
+
+calibration calibration::load(const std::string& path) {
+	std::ifstream stream{path};
+	if (!stream)
+		throw std::runtime_error(fmt::format("Failed to open '{}'", path));
+	return parse(stream, path);
+}
+
+calibration calibration::parse(std::istream& stream, std::string_view what) {
+	calibration result;
+
+	size_t number = 0;
+	for (std::string line; std::getline(stream, line);) {
+		++number;
+		line = line.substr(0, line.find('#'));
+		std::istringstream words{line};
+		std::string sensor, field, kind;
+		if (!(words >> sensor))
+			continue;
+
+		try {
+			if (!(words >> field >> kind))
+				throw std::runtime_error("Expected sensor, field, step and its parameters");
+
+			const auto* name = std::find_if(std::begin(slot_names), std::end(slot_names), [&](const slot_name& n) { return n.sensor == sensor && n.field == field; });
+			if (name == std::end(slot_names))
+				throw std::runtime_error(fmt::format("Unknown field '{}' of '{}'", field, sensor));
+
+			step s{};
+			std::string parameter;
+			if (kind == "offset" || kind == "gain") {
+				if (!(words >> parameter))
+					throw std::runtime_error(fmt::format("Missing value of {}", kind));
+				if (kind == "offset") {
+					s.kind = step::offset;
+					s.value = parse_number<int64_t>(parameter, "offset");
+				} else {
+					s.kind = step::gain;
+					s.value = fixed(parse_number<double>(parameter, "gain"));
+				}
+			} else if (kind == "curve") {
+				s.kind = step::curve;
+				while (words >> parameter) {
+					const auto colon = parameter.find(':');
+					if (colon == std::string::npos)
+						throw std::runtime_error(fmt::format("Curve point '{}' should be x:y", parameter));
+					const auto x = parse_number<int64_t>(std::string_view{parameter}.substr(0, colon), "curve point");
+					const auto y = parse_number<int64_t>(std::string_view{parameter}.substr(colon + 1), "curve point");
+					if (!s.segments.empty() && x <= s.segments.back().x)
+						throw std::runtime_error("Curve points should be in increasing order of x");
+					s.segments.push_back({x, y, 0});
+				}
+				if (s.segments.size() < 2)
+					throw std::runtime_error("Curve needs at least two points");
+				for (size_t i = 0; i + 1 < s.segments.size(); ++i) {
+					auto& a = s.segments[i];
+					const auto& b = s.segments[i + 1];
+					a.slope = fixed(static_cast<double>(b.y - a.y) / (b.x - a.x));
+				}
+				// the last point starts the extension of the last segment
+				s.segments.back().slope = s.segments[s.segments.size() - 2].slope;
+			} else {
+				throw std::runtime_error(fmt::format("Unknown step '{}'", kind));
+			}
+
+			if (kind != "curve" && words >> parameter)
+				throw std::runtime_error(fmt::format("Unexpected '{}'", parameter));
+
+			result.chains[name - std::begin(slot_names)].steps.push_back(std::move(s));
+		} catch (const std::exception& e) {
+			throw std::runtime_error(fmt::format("{}:{}: {}", what, number, e.what()));
+		}
+	}
+
+	return result;
+}
+
+uint64_t calibration::chain::apply(uint64_t reading) const {
+	if (steps.empty())
+		return reading;
+
+	auto value = static_cast<int64_t>(reading);
+	for (const auto& s : steps) {
+		switch (s.kind) {
+			case step::offset:
+				value += s.value;
+				break;
+			case step::gain:
+				value = scale(value, s.value);
+				break;
+			case step::curve: {
+				// last point at or below the value, the first one extends its segment downwards
+				auto it = std::upper_bound(s.segments.begin(), s.segments.end(), value, [](int64_t v, const segment& p) { return v < p.x; });
+				const auto& p = it == s.segments.begin() ? *it : *(it - 1);
+				value = p.y + scale(value - p.x, p.slope);
+				break;
+			}
+		}
+	}
+	return static_cast<uint64_t>(std::max<int64_t>(value, 0));
+}
+
+void calibration::apply(s8::data& data) const {
+	data.co2 = chains[s8_co2].apply(data.co2);
+}
+
+void calibration::apply(sds011::data& data) const {
+	data.deca_pm25 = chains[sds011_pm25].apply(data.deca_pm25);
+	data.deca_pm10 = chains[sds011_pm10].apply(data.deca_pm10);
+}
+
+void calibration::apply(bme280::data& data) const {
+	data.deca_humidity = chains[bme280_humidity].apply(data.deca_humidity);
+	data.deca_kelvin = chains[bme280_kelvin].apply(data.deca_kelvin);
+}
+
+void calibration::apply(bme680::data& data) const {
+	data.deca_humidity = chains[bme680_humidity].apply(data.deca_humidity);
+	data.deca_kelvin = chains[bme680_kelvin].apply(data.deca_kelvin);
+}
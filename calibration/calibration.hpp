@@ -0,0 +1,64 @@
+#pragma once
+
+#include "../bme280/bme280.hpp"
+#include "../bme680/bme680.hpp"
+#include "../s8/s8.hpp"
+#include "../sds011/sds011.hpp"
+
+#include <array>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Corrections of the readings of each sensor against a reference, one step
+ * per line, applied in the order given:
+ *
+ *   # sensor field step parameters
+ *   s8 co2 offset -12
+ *   sds011 deca_pm25 gain 0.87
+ *   sds011 deca_pm10 curve 0:0 200:180 1000:850
+ *   bme680 deca_kelvin offset -15
+ *
+ * Offsets and curve points are in the units of the field. Gains and curve
+ * slopes become 16.16 fixed point when loaded, so correcting a reading is a
+ * few integer operations. Curves extend their outer segments and results
+ * below zero are clamped.
+ */
+class calibration {
+ public:
+	static calibration load(const std::string& path);
+
+	// what names the source in errors
+	static calibration parse(std::istream&, std::string_view what);
+
+	void apply(s8::data&) const;
+	void apply(sds011::data&) const;
+	void apply(bme280::data&) const;
+	void apply(bme680::data&) const;
+
+ private:
+	struct segment {
+		int64_t x;
+		int64_t y;
+		int64_t slope;
+	};
+
+	struct step {
+		enum { offset, gain, curve } kind;
+		int64_t value;
+		std::vector<segment> segments;
+	};
+
+	struct chain {
+		std::vector<step> steps;
+
+		[[nodiscard]] uint64_t apply(uint64_t) const;
+	};
+
+	enum slot { s8_co2, sds011_pm25, sds011_pm10, bme280_humidity, bme280_kelvin, bme680_humidity, bme680_kelvin, slots };
+
+	std::array<chain, slots> chains;
+};
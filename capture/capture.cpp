@@ -0,0 +1,168 @@
+#include "capture.hpp"
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+
+namespace capture {
+namespace {
+constexpr char magic[8] = {'A', 'I', 'R', 'C', 'A', 'P', 0, 1};
+constexpr size_t header_size = sizeof(magic) + sizeof(uint64_t);
+constexpr size_t entry_size = 20;
+
+std::string_view op_name(op what) {
+	switch (what) {
+		case op::channel:
+			return "channel";
+		case op::write:
+			return "write";
+		case op::read:
+			return "read";
+		case op::i2c_read8:
+			return "i2c read8";
+		case op::i2c_write8:
+			return "i2c write8";
+		case op::i2c_read_reg8:
+			return "i2c read_reg8";
+		case op::i2c_read_reg16:
+			return "i2c read_reg16";
+		case op::i2c_write_reg8:
+			return "i2c write_reg8";
+		case op::open:
+			return "open";
+	}
+	return "unknown";
+}
+};  // namespace
+
+writer* writer::active = nullptr;
+reader* reader::active = nullptr;
+
+writer::writer(const std::string& path) : file{fopen(path.c_str(), "wb")}, epoch{std::chrono::steady_clock::now()} {
+	if (!file)
+		throw std::runtime_error(fmt::format("Failed to open '{}': {}", path, strerror(errno)));
+
+	const uint64_t started = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	fwrite(magic, sizeof(magic), 1, file);
+	fwrite(&started, sizeof(started), 1, file);
+}
+
+writer::~writer() {
+	if (active == this)
+		active = nullptr;
+	fclose(file);
+}
+
+uint16_t writer::channel(std::string_view name) {
+	for (size_t i = 0; i < channels.size(); ++i)
+		if (channels[i] == name)
+			return i;
+
+	channels.emplace_back(name);
+	const uint16_t id = channels.size() - 1;
+	add(id, op::channel, 0, reinterpret_cast<const uint8_t*>(name.data()), name.size());
+	return id;
+}
+
+void writer::add(uint16_t channel, op what, int32_t result, const uint8_t* data, size_t size) {
+	const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+	const uint32_t bytes = size;
+
+	uint8_t head[entry_size] = {};
+	memcpy(&head[0], &ns, sizeof(ns));
+	memcpy(&head[8], &channel, sizeof(channel));
+	head[10] = static_cast<uint8_t>(what);
+	memcpy(&head[12], &result, sizeof(result));
+	memcpy(&head[16], &bytes, sizeof(bytes));
+
+	fwrite(head, sizeof(head), 1, file);
+	if (size)
+		fwrite(data, size, 1, file);
+}
+
+void writer::flush() {
+	fflush(file);
+}
+
+reader::reader(const std::string& path, bool r) : realtime{r}, epoch{std::chrono::steady_clock::now()} {
+	std::ifstream stream{path, std::ios::binary};
+	if (!stream)
+		throw std::runtime_error(fmt::format("Failed to open '{}': {}", path, strerror(errno)));
+	content.assign(std::istreambuf_iterator<char>{stream}, {});
+
+	if (content.size() < header_size || content.compare(0, sizeof(magic), magic, sizeof(magic)) != 0)
+		throw std::runtime_error(fmt::format("'{}' is not a capture", path));
+
+	// a recording cut short by a crash ends in a partial entry, which is dropped
+	for (size_t at = header_size; at + entry_size <= content.size();) {
+		entry e;
+		uint32_t bytes;
+		memcpy(&e.ns, &content[at], sizeof(e.ns));
+		memcpy(&e.channel, &content[at + 8], sizeof(e.channel));
+		e.what = static_cast<op>(content[at + 10]);
+		memcpy(&e.result, &content[at + 12], sizeof(e.result));
+		memcpy(&bytes, &content[at + 16], sizeof(bytes));
+		at += entry_size;
+		if (at + bytes > content.size())
+			break;
+		e.data = std::string_view{&content[at], bytes};
+		at += bytes;
+
+		if (e.what == op::channel) {
+			if (e.channel != channels.size())
+				throw std::runtime_error(fmt::format("'{}' has channel {} out of order", path, e.channel));
+			channels.push_back(e.data);
+			queues.emplace_back();
+			continue;
+		}
+		if (e.channel >= channels.size())
+			throw std::runtime_error(fmt::format("'{}' uses channel {} before naming it", path, e.channel));
+
+		queues[e.channel].push_back(all.size());
+		all.push_back(e);
+	}
+	positions.assign(queues.size(), 0);
+}
+
+bool reader::has(std::string_view name) const {
+	return std::find(channels.begin(), channels.end(), name) != channels.end();
+}
+
+uint16_t reader::channel(std::string_view name) const {
+	for (size_t i = 0; i < channels.size(); ++i)
+		if (channels[i] == name)
+			return i;
+	throw std::runtime_error(fmt::format("'{}' is not in the recording", name));
+}
+
+const reader::entry& reader::next(uint16_t channel, op what, std::string_view request) {
+	auto& position = positions[channel];
+	if (position == queues[channel].size())
+		throw std::runtime_error(fmt::format("Replay of '{}' is over", channels[channel]));
+
+	const auto& e = all[queues[channel][position]];
+	if (e.what != what || e.data.substr(0, request.size()) != request) {
+		// nothing after that point can match anymore, the channel is given up
+		position = queues[channel].size();
+		throw std::runtime_error(fmt::format("Replay of '{}' diverged: driver did {}, recording has {}", channels[channel], op_name(what), op_name(e.what)));
+	}
+	++position;
+
+	if (realtime)
+		std::this_thread::sleep_until(epoch + std::chrono::nanoseconds{e.ns});
+	return e;
+}
+
+bool reader::finished() const {
+	for (size_t i = 0; i < queues.size(); ++i)
+		if (positions[i] != queues[i].size())
+			return false;
+	return true;
+}
+
+};  // namespace capture
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Raw serial and I2C traffic of the drivers, with timestamps, so that a run
+ * can be fed back through the same drivers. Every device is a channel named
+ * by its path. Entries are written in host byte order:
+ *
+ *   header  "AIRCAP\0\1", u64 realtime ns of the start
+ *   entry   u64 ns since start, u16 channel, u8 op, u8 0, i32 result, u32 size, size bytes
+ *
+ * A channel entry carries the name and comes before the first use of it.
+ */
+namespace capture {
+
+enum class op : uint8_t {
+	channel,
+	// serial, result is what read(2) and write(2) returned, or -errno
+	write,
+	read,
+	// i2c, bytes are the register and the value, result is 0 or -errno
+	i2c_read8,
+	i2c_write8,
+	i2c_read_reg8,
+	i2c_read_reg16,
+	i2c_write_reg8,
+	// opening the device, result is 0 or -errno
+	open,
+};
+
+class writer {
+ public:
+	explicit writer(const std::string& path);
+	explicit writer(writer&&) = delete;
+
+	~writer();
+
+	[[nodiscard]] uint16_t channel(std::string_view name);
+
+	void add(uint16_t channel, op, int32_t result, const uint8_t* data, size_t size);
+
+	void flush();
+
+	// set while recording, drivers opened meanwhile are recorded
+	static writer* active;
+
+ private:
+	FILE* file;
+	std::chrono::steady_clock::time_point epoch;
+	std::vector<std::string> channels;
+};
+
+class reader {
+ public:
+	struct entry {
+		uint64_t ns;
+		uint16_t channel;
+		op what;
+		int32_t result;
+		std::string_view data;
+	};
+
+	// realtime replays with the recorded pauses, otherwise as fast as the drivers go
+	reader(const std::string& path, bool realtime);
+	explicit reader(reader&&) = delete;
+
+	[[nodiscard]] bool has(std::string_view channel) const;
+
+	// throws if the recording has no such channel
+	[[nodiscard]] uint16_t channel(std::string_view name) const;
+
+	// next entry of the channel, throws if the driver does something else than was recorded,
+	// request is what the driver sends and has to be where the recorded bytes start
+	const entry& next(uint16_t channel, op, std::string_view request = {});
+
+	// every channel was replayed to its end or given up on
+	[[nodiscard]] bool finished() const;
+
+	[[nodiscard]] const std::vector<entry>& entries() const {
+		return all;
+	}
+
+	// set while replaying, drivers opened meanwhile are fed from the recording
+	static reader* active;
+
+ private:
+	std::string content;
+	std::vector<std::string_view> channels;
+	std::vector<entry> all;
+	// per channel, indices into all and the next one to replay
+	std::vector<std::vector<size_t>> queues;
+	std::vector<size_t> positions;
+	bool realtime;
+	std::chrono::steady_clock::time_point epoch;
+};
+
+};  // namespace capture
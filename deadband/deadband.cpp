@@ -0,0 +1,68 @@
+#include "deadband.hpp"
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+#include <variant>
+
+deadband::band deadband::band::parse(std::string_view spec) {
+	const auto eq = spec.find('=');
+	if (eq == std::string_view::npos || !eq)
+		throw std::runtime_error(fmt::format("Deadband '{}' should be key=N or key=N%", spec));
+
+	auto number = spec.substr(eq + 1);
+	const bool percent = !number.empty() && number.back() == '%';
+	if (percent)
+		number.remove_suffix(1);
+
+	double width{};
+	if (auto [end, ec] = std::from_chars(number.data(), number.data() + number.size(), width); ec != std::errc{} || end != number.data() + number.size() || width < 0)
+		throw std::runtime_error(fmt::format("Failed to parse deadband width '{}'", spec.substr(eq + 1)));
+
+	band result{.key = std::string{spec.substr(0, eq)}};
+	if (percent)
+		result.relative = width / 100;
+	else
+		result.absolute = width;
+	return result;
+}
+
+deadband::deadband(std::vector<band> bands, clock::duration h, const std::vector<std::string>& known) : heartbeat{h} {
+	for (auto& b : bands) {
+		// a misspelled key would never match and leave only the heartbeat
+		if (std::find(known.begin(), known.end(), b.key) == known.end())
+			throw std::runtime_error(fmt::format("Unknown deadband field '{}', records have {}", b.key, fmt::join(known, ", ")));
+		fields.push_back({std::move(b), std::nullopt});
+	}
+}
+
+bool deadband::moved(const record& rec, clock::time_point now, bool partial) {
+	bool changed = !last_report || now - *last_report >= heartbeat;
+
+	for (const auto& f : fields) {
+		const auto* current = rec.find(f.limits.key);
+		if (!current && partial)
+			continue;
+		if (!current || !f.last) {
+			changed |= static_cast<bool>(current) != f.last.has_value();
+			continue;
+		}
+		const double value = std::visit([](auto v) { return static_cast<double>(v); }, current->val);
+		const double width = std::max(f.limits.absolute, f.limits.relative * std::abs(*f.last));
+		changed |= std::abs(value - *f.last) > width;
+	}
+
+	if (!changed)
+		return false;
+
+	last_report = now;
+	for (auto& f : fields) {
+		const auto* current = rec.find(f.limits.key);
+		if (!current && partial)
+			continue;
+		f.last = current ? std::optional{std::visit([](auto v) { return static_cast<double>(v); }, current->val)} : std::nullopt;
+	}
+	return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "../record/record.hpp"
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Decides on the typed record, before anything is encoded, whether a report is
+ * worth sending: some watched field moved out of its band around the value
+ * last reported, appeared or vanished, or the heartbeat is due. Fields
+ * without a band ride along but never cause a report.
+ */
+class deadband {
+ public:
+	using clock = std::chrono::steady_clock;
+
+	struct band {
+		std::string key;
+		double absolute = 0;
+		// fraction of the value last reported
+		double relative = 0;
+
+		// key=N or key=N%, e.g. co2=20 or deca_pm25=10%
+		static band parse(std::string_view);
+	};
+
+	// fields are all the keys a record can have, a band on any other key is an error
+	deadband(std::vector<band>, clock::duration heartbeat, const std::vector<std::string>& fields);
+
+	// true if the record should go out, its watched values are then remembered
+	// in a partial record, as with adaptive sampling, a missing field was not read this time rather than lost
+	[[nodiscard]] bool moved(const record&, clock::time_point now, bool partial = false);
+
+ private:
+	struct watched {
+		band limits;
+		std::optional<double> last;
+	};
+
+	std::vector<watched> fields;
+	clock::duration heartbeat;
+	std::optional<clock::time_point> last_report;
+};
@@ -0,0 +1,153 @@
+#include "bme280_chip.hpp"
+#include "../bme280/compensation.hpp"
+
+#include <cstring>
+
+namespace {
+using namespace bme280_compensation;
+
+constexpr uint8_t chip_id = 0xD0;
+constexpr uint8_t reset = 0xE0;
+constexpr uint8_t control_humidity = 0xF2;
+constexpr uint8_t control = 0xF4;
+constexpr uint8_t config = 0xF5;
+constexpr uint8_t data = 0xF7;
+
+constexpr double deca_kelvin_zero = 2731.5;
+
+// example calibration from the datasheet, section 8.2
+const bme280_calib_data calibration = {
+    .dig_T1 = 27504, .dig_T2 = 26435, .dig_T3 = -1000, .dig_P1 = 36477, .dig_P2 = -10685, .dig_P3 = 3024, .dig_P4 = 2855, .dig_P5 = 140, .dig_P6 = -7,
+    .dig_P7 = 15500, .dig_P8 = -14600, .dig_P9 = 6000, .dig_H1 = 75, .dig_H2 = 362, .dig_H3 = 0, .dig_H4 = 313, .dig_H5 = 50, .dig_H6 = 30,
+};
+
+void put16(uint8_t* at, int32_t value) {
+	at[0] = value & 0xff;
+	at[1] = (value >> 8) & 0xff;
+}
+
+void put20(uint8_t* at, uint32_t value) {
+	at[0] = value >> 12;
+	at[1] = value >> 4;
+	at[2] = (value & 0xf) << 4;
+}
+
+// smallest 20 bit ADC value whose compensated value reaches target, f is monotonic either way
+template <typename F>
+uint32_t invert(F&& f, double target, uint32_t high) {
+	const bool rising = f(high) > f(0);
+	uint32_t low = 0;
+	while (low < high) {
+		const uint32_t mid = low + (high - low) / 2;
+		if ((f(mid) < target) == rising)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+};  // namespace
+
+namespace emu {
+bme280_chip::bme280_chip(std::chrono::nanoseconds l) : latency{l}, pointer{0}, adc_p{0}, adc_t{0}, adc_h{0} {
+	memset(registers, 0, sizeof(registers));
+	registers[chip_id] = 0x60;
+
+	put16(&registers[0x88], calibration.dig_T1);
+	put16(&registers[0x8A], calibration.dig_T2);
+	put16(&registers[0x8C], calibration.dig_T3);
+	put16(&registers[0x8E], calibration.dig_P1);
+	put16(&registers[0x90], calibration.dig_P2);
+	put16(&registers[0x92], calibration.dig_P3);
+	put16(&registers[0x94], calibration.dig_P4);
+	put16(&registers[0x96], calibration.dig_P5);
+	put16(&registers[0x98], calibration.dig_P6);
+	put16(&registers[0x9A], calibration.dig_P7);
+	put16(&registers[0x9C], calibration.dig_P8);
+	put16(&registers[0x9E], calibration.dig_P9);
+	registers[0xA1] = calibration.dig_H1;
+	put16(&registers[0xE1], calibration.dig_H2);
+	registers[0xE3] = calibration.dig_H3;
+	// H4 and H5 are 12 bit and share the nibbles of 0xE5
+	registers[0xE4] = calibration.dig_H4 >> 4;
+	registers[0xE5] = (calibration.dig_H4 & 0xf) | ((calibration.dig_H5 & 0xf) << 4);
+	registers[0xE6] = calibration.dig_H5 >> 4;
+	registers[0xE7] = calibration.dig_H6;
+
+	// values after reset, until the first measurement
+	put20(&registers[data], 0x80000);
+	put20(&registers[data + 3], 0x80000);
+	registers[data + 6] = 0x80;
+
+	set(2951, 452, 10132);
+}
+
+void bme280_chip::set(uint64_t deca_kelvin, uint64_t deca_humidity, uint64_t deca_pressure) {
+	const double deca_celsius = deca_kelvin - deca_kelvin_zero;
+	adc_t = invert([](uint32_t adc) { return deca_celcius(get_temperature_calibration(calibration, adc)); }, deca_celsius, (1u << 20) - 1);
+
+	const auto t_fine = get_temperature_calibration(calibration, adc_t);
+	adc_p = invert([t_fine](uint32_t adc) { return bme280_compensation::deca_pressure(adc, calibration, t_fine); }, deca_pressure, (1u << 20) - 1);
+	adc_h = invert([t_fine](uint32_t adc) { return bme280_compensation::deca_humidity(adc, calibration, t_fine); }, deca_humidity, (1u << 16) - 1);
+
+	latch();
+}
+
+void bme280_chip::latch() {
+	if (!(registers[control] & 0x3))
+		return;
+	put20(&registers[data], adc_p);
+	put20(&registers[data + 3], adc_t);
+	registers[data + 6] = adc_h >> 8;
+	registers[data + 7] = adc_h & 0xff;
+}
+
+void bme280_chip::transaction() {
+	++transactions;
+	if (latency.count() > 0) {
+		const auto until = std::chrono::steady_clock::now() + latency;
+		while (std::chrono::steady_clock::now() < until) {
+		}
+	}
+}
+
+uint8_t bme280_chip::read8() {
+	transaction();
+	return registers[pointer++];
+}
+
+void bme280_chip::write8(uint8_t reg) {
+	transaction();
+	pointer = reg;
+}
+
+uint8_t bme280_chip::read_reg8(uint8_t reg) {
+	transaction();
+	pointer = reg + 1;
+	return registers[reg];
+}
+
+uint16_t bme280_chip::read_reg16(uint8_t reg) {
+	transaction();
+	pointer = reg + 2;
+	return registers[reg] | (registers[uint8_t(reg + 1)] << 8);
+}
+
+void bme280_chip::write_reg8(uint8_t reg, uint8_t value) {
+	transaction();
+	if (reg == reset) {
+		// soft reset only on the magic value, registers keep calibration
+		if (value == 0xB6)
+			registers[control] = 0;
+		return;
+	}
+	// everything else is read only
+	if (reg != control_humidity && reg != control && reg != config)
+		return;
+	registers[reg] = value;
+
+	// leaving sleep mode latches a measurement
+	if (reg == control)
+		latch();
+}
+};  // namespace emu
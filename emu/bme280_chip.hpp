@@ -0,0 +1,37 @@
+#pragma once
+
+#include "../i2c/i2c.hpp"
+
+#include <chrono>
+#include <cstdint>
+
+namespace emu {
+// in-process BME280 with the datasheet register map and calibration, readings are set in physical units
+class bme280_chip : public i2c::bus {
+ public:
+	explicit bme280_chip(std::chrono::nanoseconds latency = {});
+
+	[[nodiscard]] uint8_t read8() override;
+	void write8(uint8_t reg) override;
+	[[nodiscard]] uint8_t read_reg8(uint8_t reg) override;
+	[[nodiscard]] uint16_t read_reg16(uint8_t reg) override;
+	void write_reg8(uint8_t reg, uint8_t value) override;
+
+	// raw ADC values are searched for, so that the driver's compensation gives these back
+	void set(uint64_t deca_kelvin, uint64_t deca_humidity, uint64_t deca_pressure);
+
+ private:
+	// every transaction takes that long, busy waiting to stay accurate below the scheduler tick
+	void transaction();
+	// copies the ADC values into the data registers unless in sleep mode
+	void latch();
+
+	std::chrono::nanoseconds latency;
+	uint8_t registers[256];
+	uint8_t pointer;
+	// measurements show up only after the driver left sleep mode
+	uint32_t adc_p;
+	uint32_t adc_t;
+	uint32_t adc_h;
+};
+};  // namespace emu
@@ -0,0 +1,266 @@
+#include "emulator.hpp"
+#include "../s8/s8.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+constexpr uint8_t s8_request[7] = {0xFE, 0x44, 0x00, 0x08, 0x02, 0x9F, 0x25};
+
+constexpr size_t sds011_request_size = 19;
+constexpr uint8_t sds011_query = 4;
+constexpr uint8_t sds011_firmware = 7;
+
+bool happens(std::mt19937& random, double probability) {
+	return probability > 0 && std::uniform_real_distribution<double>{0, 1}(random) < probability;
+}
+
+uint16_t drift(std::mt19937& random, uint16_t value, int step, uint16_t low, uint16_t high) {
+	return std::clamp<int>(value + std::uniform_int_distribution<int>{-step, step}(random), low, high);
+}
+
+std::vector<uint8_t> s8_reply(uint16_t co2) {
+	std::vector<uint8_t> frame{0xFE, 0x44, 0x02, uint8_t(co2 >> 8), uint8_t(co2)};
+	const auto crc = s8::crc16(frame.data(), frame.size());
+	frame.push_back(crc & 0xff);
+	frame.push_back(crc >> 8);
+	return frame;
+}
+
+// AA head d1 d2 d3 d4 id id checksum AB
+std::vector<uint8_t> sds011_reply(uint8_t head, uint8_t d1, uint8_t d2, uint8_t d3, uint8_t d4) {
+	std::vector<uint8_t> frame{0xAA, head, d1, d2, d3, d4, 0x34, 0x12};
+	frame.push_back(std::accumulate(frame.begin() + 2, frame.end(), 0u));
+	frame.push_back(0xAB);
+	return frame;
+}
+};  // namespace
+
+namespace emu {
+pty::pty(const std::string& l) : link{l}, master{posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK)}, slave{-1} {
+	if (master < 0)
+		throw std::runtime_error(fmt::format("Failed to open pty: {}", strerror(errno)));
+
+	try {
+		if (grantpt(master) < 0 || unlockpt(master) < 0)
+			throw std::runtime_error(fmt::format("Failed to unlock pty: {}", strerror(errno)));
+
+		const char* name = ptsname(master);
+		if (!name)
+			throw std::runtime_error(fmt::format("Failed to name pty: {}", strerror(errno)));
+
+		slave = open(name, O_RDWR | O_NOCTTY);
+		if (slave < 0)
+			throw std::runtime_error(fmt::format("Failed to open '{}': {}", name, strerror(errno)));
+
+		// the drivers switch to raw mode themselves, this only covers the time before they do
+		termios tty;
+		if (tcgetattr(slave, &tty) == 0) {
+			cfmakeraw(&tty);
+			tcsetattr(slave, TCSANOW, &tty);
+		}
+
+		struct stat st;
+		if (lstat(link.c_str(), &st) == 0) {
+			if (!S_ISLNK(st.st_mode))
+				throw std::runtime_error(fmt::format("Refusing to replace '{}', it is not a symlink", link));
+			unlink(link.c_str());
+		}
+		if (symlink(name, link.c_str()) < 0)
+			throw std::runtime_error(fmt::format("Failed to link '{}' to '{}': {}", link, name, strerror(errno)));
+	} catch (...) {
+		if (slave >= 0)
+			close(slave);
+		close(master);
+		throw;
+	}
+}
+
+pty::~pty() {
+	unlink(link.c_str());
+	close(slave);
+	close(master);
+}
+
+serial::serial(protocol p, const std::string& l, const faults& f, uint32_t seed) : proto{p}, link{l}, fault{f}, random{seed} {
+	connect();
+}
+
+void serial::connect() {
+	line.emplace(link);
+	reconnect_at.reset();
+	input.clear();
+}
+
+void serial::hang_up(clock::time_point now) {
+	++disconnects;
+	line.reset();
+	pending.clear();
+	reconnect_at = now + fault.reconnect;
+}
+
+int serial::fd() const {
+	return line ? line->fd() : -1;
+}
+
+std::optional<clock::time_point> serial::deadline() const {
+	if (reconnect_at)
+		return reconnect_at;
+	if (!pending.empty())
+		return pending.front().due;
+	return std::nullopt;
+}
+
+void serial::step(clock::time_point now, bool readable) {
+	if (reconnect_at) {
+		if (now >= *reconnect_at)
+			connect();
+		return;
+	}
+
+	if (readable) {
+		uint8_t buffer[256];
+		ssize_t bytes;
+		while ((bytes = read(line->fd(), buffer, sizeof(buffer))) > 0)
+			input.insert(input.end(), buffer, buffer + bytes);
+		parse(now);
+		if (reconnect_at)
+			return;
+	}
+
+	while (!pending.empty() && pending.front().due <= now) {
+		const auto& frame = pending.front().frame;
+		if (write(line->fd(), frame.data(), frame.size()) != ssize_t(frame.size()))
+			fmt::print(stderr, "Failed to reply on '{}': {}\n", link, strerror(errno));
+		++replies;
+		pending.pop_front();
+		if (served)
+			served(clock::now());
+	}
+}
+
+void serial::parse(clock::time_point now) {
+	const uint8_t head = proto == protocol::s8 ? s8_request[0] : 0xAA;
+	const size_t size = proto == protocol::s8 ? std::size(s8_request) : sds011_request_size;
+
+	for (;;) {
+		// resync on the frame head, anything before it is line noise
+		input.erase(input.begin(), std::find(input.begin(), input.end(), head));
+		if (input.size() < size)
+			return;
+
+		bool valid;
+		if (proto == protocol::s8)
+			valid = std::equal(input.begin(), input.begin() + size, std::begin(s8_request));
+		else
+			valid = input[1] == 0xB4 && input[18] == 0xAB && input[17] == uint8_t(std::accumulate(input.begin() + 2, input.begin() + 17, 0u));
+
+		if (!valid) {
+			input.erase(input.begin());
+			continue;
+		}
+
+		++requests;
+		if (happens(random, fault.disconnect)) {
+			hang_up(now);
+			return;
+		}
+
+		if (proto == protocol::s8) {
+			schedule(now, s8_reply(co2));
+		} else if (input[2] == sds011_query) {
+			schedule(now, sds011_reply(0xC0, deca_pm25 & 0xff, deca_pm25 >> 8, deca_pm10 & 0xff, deca_pm10 >> 8));
+		} else if (input[2] == sds011_firmware) {
+			schedule(now, sds011_reply(0xC5, sds011_firmware, 18, 11, 16));
+		} else {
+			// settings are acknowledged by echoing them
+			schedule(now, sds011_reply(0xC5, input[2], input[3], input[4], 0));
+		}
+		input.erase(input.begin(), input.begin() + size);
+	}
+}
+
+void serial::schedule(clock::time_point now, std::vector<uint8_t>&& frame) {
+	if (happens(random, fault.corrupt)) {
+		// only the payload, so the frame is still recognized and fails its checksum
+		const auto bit = std::uniform_int_distribution<size_t>{16, frame.size() * 8 - 17}(random);
+		frame[bit / 8] ^= 1u << (bit % 8);
+		++corrupted;
+	}
+
+	auto due = now + fault.latency;
+	if (fault.jitter.count() > 0)
+		due += std::chrono::microseconds{std::uniform_int_distribution<int64_t>{0, fault.jitter.count()}(random)};
+	// replies leave in order even if jitter says otherwise
+	if (!pending.empty())
+		due = std::max(due, pending.back().due);
+	pending.push_back({due, std::move(frame)});
+
+	advance();
+}
+
+void serial::advance() {
+	if (!walk)
+		return;
+	if (proto == protocol::s8) {
+		co2 = drift(random, co2, 5, 400, 5000);
+	} else {
+		deca_pm25 = drift(random, deca_pm25, 3, 0, 9999);
+		deca_pm10 = drift(random, deca_pm10, 4, deca_pm25, 9999);
+	}
+}
+
+climate::climate(const std::string& p, std::chrono::milliseconds per, const faults& f, uint32_t seed)
+    : path{p}, period{per}, fault{f}, random{seed}, next{clock::now()} {}
+
+climate::~climate() {
+	unlink(path.c_str());
+}
+
+void climate::step(clock::time_point now, bool) {
+	if (now < next)
+		return;
+	next = now + period;
+
+	if (happens(random, fault.disconnect)) {
+		// the fetcher died, readers find no file until it is restarted
+		++disconnects;
+		unlink(path.c_str());
+		next = now + fault.reconnect;
+		return;
+	}
+
+	std::string output;
+	if (happens(random, fault.corrupt)) {
+		++corrupted;
+		output = "\"deca_humidity\":";
+	} else {
+		deca_humidity = drift(random, deca_humidity, 5, 0, 1000);
+		deca_kelvin = drift(random, deca_kelvin, 2, 2331, 3331);
+		gas = std::max(1000.0, gas + std::uniform_real_distribution<double>{-500, 500}(random));
+		output = fmt::format("\"deca_humidity\":{},\"deca_kelvin\":{},\"gas\":{:.2f}", deca_humidity, deca_kelvin, gas);
+	}
+
+	// same as the fetcher, readers never see a half written file
+	const auto tmp = path + ".tmp";
+	if (FILE* file = fopen(tmp.c_str(), "w")) {
+		fputs(output.c_str(), file);
+		fclose(file);
+		if (rename(tmp.c_str(), path.c_str()) == 0) {
+			++replies;
+			return;
+		}
+	}
+	fmt::print(stderr, "Failed to write '{}': {}\n", path, strerror(errno));
+}
+};  // namespace emu
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace emu {
+using clock = std::chrono::steady_clock;
+
+struct faults {
+	// every reply is delayed by latency plus a uniform share of jitter
+	std::chrono::microseconds latency{0};
+	std::chrono::microseconds jitter{0};
+	// probability of flipping a bit in a reply
+	double corrupt = 0;
+	// probability of hanging up instead of replying, the device comes back after reconnect
+	double disconnect = 0;
+	std::chrono::milliseconds reconnect{1000};
+};
+
+// pseudo-terminal whose slave side is reachable through a symlink, like /dev/serial/by-id
+class pty {
+ public:
+	explicit pty(const std::string& link);
+	pty(const pty&) = delete;
+
+	~pty();
+
+	[[nodiscard]] int fd() const {
+		return master;
+	}
+
+ private:
+	std::string link;
+	int master;
+	// kept open so the master does not see a hangup while the driver reopens the device
+	int slave;
+};
+
+// one emulated device, driven by a poll loop: wait for fd() or until deadline(), then step()
+class device {
+ public:
+	virtual ~device() = default;
+
+	// -1 while there is nothing to read
+	[[nodiscard]] virtual int fd() const = 0;
+	[[nodiscard]] virtual std::optional<clock::time_point> deadline() const = 0;
+	virtual void step(clock::time_point now, bool readable) = 0;
+
+	uint64_t requests = 0;
+	uint64_t replies = 0;
+	uint64_t corrupted = 0;
+	uint64_t disconnects = 0;
+};
+
+// Senseair S8 modbus and Nova SDS011 query protocols over a pty
+class serial : public device {
+ public:
+	enum class protocol { s8, sds011 };
+
+	serial(protocol, const std::string& link, const faults&, uint32_t seed);
+
+	[[nodiscard]] int fd() const override;
+	[[nodiscard]] std::optional<clock::time_point> deadline() const override;
+	void step(clock::time_point now, bool readable) override;
+
+	// random walk values, overwrite them to serve something specific
+	uint16_t co2 = 600;
+	uint16_t deca_pm25 = 80;
+	uint16_t deca_pm10 = 120;
+	bool walk = true;
+
+	// called right after a reply reached the pty
+	std::function<void(clock::time_point)> served;
+
+ private:
+	struct reply {
+		clock::time_point due;
+		std::vector<uint8_t> frame;
+	};
+
+	void connect();
+	void hang_up(clock::time_point now);
+	void parse(clock::time_point now);
+	void schedule(clock::time_point now, std::vector<uint8_t>&& frame);
+	void advance();
+
+	protocol proto;
+	std::string link;
+	faults fault;
+	std::mt19937 random;
+	std::optional<pty> line;
+	std::optional<clock::time_point> reconnect_at;
+	std::vector<uint8_t> input;
+	std::deque<reply> pending;
+};
+
+// file the bme680 fetcher script would keep up to date
+class climate : public device {
+ public:
+	climate(const std::string& path, std::chrono::milliseconds period, const faults&, uint32_t seed);
+
+	~climate() override;
+
+	[[nodiscard]] int fd() const override {
+		return -1;
+	}
+	[[nodiscard]] std::optional<clock::time_point> deadline() const override {
+		return next;
+	}
+	void step(clock::time_point now, bool readable) override;
+
+	uint64_t deca_humidity = 450;
+	uint64_t deca_kelvin = 2950;
+	double gas = 50000;
+
+ private:
+	std::string path;
+	std::chrono::milliseconds period;
+	faults fault;
+	std::mt19937 random;
+	clock::time_point next;
+};
+};  // namespace emu
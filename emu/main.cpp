@@ -0,0 +1,114 @@
+#include "emulator.hpp"
+
+#include "../lib/cxxopts.hpp"
+
+#include <poll.h>
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+volatile std::sig_atomic_t stop_requested = 0;
+
+void request_stop(int) {
+	stop_requested = 1;
+}
+};  // namespace
+
+int main(int argc, char** argv) {
+	cxxopts::Options options("air_emu", "Emulated air sensors");
+
+	std::string s8_path;
+	std::string sds011_path;
+	std::string bme680_path;
+	uint bme680_period = 1000;
+	uint latency_ms = 0;
+	uint jitter_ms = 0;
+	double corrupt = 0;
+	double disconnect = 0;
+	uint reconnect_ms = 1000;
+	uint32_t seed = 1;
+
+	options.add_options()
+		("s8", "symlink to create for the emulated S8, pass it to air --s8-path", cxxopts::value<std::string>(s8_path))
+		("sds011", "symlink to create for the emulated SDS011, pass it to air --sds011-path", cxxopts::value<std::string>(sds011_path))
+		("bme680", "file to keep bme680 readings in, pass it to air --bme680-path", cxxopts::value<std::string>(bme680_path))
+		("bme680-period", "milliseconds between bme680 readings", cxxopts::value<uint>(bme680_period))
+		("latency", "milliseconds before every reply", cxxopts::value<uint>(latency_ms))
+		("jitter", "up to that many milliseconds added to latency", cxxopts::value<uint>(jitter_ms))
+		("corrupt", "probability of a reply with a bad checksum", cxxopts::value<double>(corrupt))
+		("disconnect", "probability of hanging up instead of replying", cxxopts::value<double>(disconnect))
+		("reconnect", "milliseconds until a hung up device comes back", cxxopts::value<uint>(reconnect_ms))
+		("seed", "seed for values and faults", cxxopts::value<uint32_t>(seed))
+		("help", "Print help");
+
+	auto result = options.parse(argc, argv);
+
+	if (result.count("help") || (s8_path.empty() && sds011_path.empty() && bme680_path.empty())) {
+		fmt::print("{}\n", options.help({""}));
+		exit(0);
+	}
+
+	const emu::faults fault{
+	    .latency = std::chrono::milliseconds{latency_ms},
+	    .jitter = std::chrono::milliseconds{jitter_ms},
+	    .corrupt = corrupt,
+	    .disconnect = disconnect,
+	    .reconnect = std::chrono::milliseconds{reconnect_ms},
+	};
+
+	std::vector<std::unique_ptr<emu::device>> devices;
+	try {
+		if (!s8_path.empty())
+			devices.push_back(std::make_unique<emu::serial>(emu::serial::protocol::s8, s8_path, fault, seed));
+		if (!sds011_path.empty())
+			devices.push_back(std::make_unique<emu::serial>(emu::serial::protocol::sds011, sds011_path, fault, seed + 1));
+		if (!bme680_path.empty())
+			devices.push_back(std::make_unique<emu::climate>(bme680_path, std::chrono::milliseconds{bme680_period}, fault, seed + 2));
+	} catch (const std::exception& e) {
+		fmt::print(stderr, "Failed to start: {}\n", e.what());
+		return 1;
+	}
+
+	// leave the loop cleanly, so that the links are removed
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = request_stop;
+	sigaction(SIGINT, &action, nullptr);
+	sigaction(SIGTERM, &action, nullptr);
+
+	std::vector<pollfd> fds(devices.size());
+	while (!stop_requested) {
+		auto now = emu::clock::now();
+		auto wake = now + std::chrono::seconds{1};
+		for (size_t i = 0; i < devices.size(); ++i) {
+			fds[i] = {.fd = devices[i]->fd(), .events = POLLIN, .revents = 0};
+			if (const auto deadline = devices[i]->deadline())
+				wake = std::min(wake, *deadline);
+		}
+
+		const auto timeout = std::chrono::ceil<std::chrono::milliseconds>(std::max(wake - now, emu::clock::duration::zero()));
+		if (poll(fds.data(), fds.size(), static_cast<int>(timeout.count())) < 0 && errno != EINTR) {
+			fmt::print(stderr, "Failed to poll: {}\n", strerror(errno));
+			return 1;
+		}
+
+		now = emu::clock::now();
+		for (size_t i = 0; i < devices.size(); ++i) {
+			try {
+				devices[i]->step(now, fds[i].revents & POLLIN);
+			} catch (const std::exception& e) {
+				fmt::print(stderr, "Device failed: {}\n", e.what());
+			}
+		}
+	}
+
+	for (const auto& device : devices)
+		fmt::print(stderr, "requests: {}, replies: {}, corrupted: {}, disconnects: {}\n", device->requests, device->replies, device->corrupted, device->disconnects);
+}
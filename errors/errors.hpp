@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdexcept>
+
+// driver failures that are told apart in statistics
+
+struct crc_error : std::runtime_error {
+	using std::runtime_error::runtime_error;
+};
+
+struct short_read_error : std::runtime_error {
+	using std::runtime_error::runtime_error;
+};
+
+// a record too large for the transport, retrying it never helps
+struct message_size_error : std::runtime_error {
+	using std::runtime_error::runtime_error;
+};
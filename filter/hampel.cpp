@@ -0,0 +1,92 @@
+#include "hampel.hpp"
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+// MAD to standard deviation of normally distributed samples
+constexpr double mad_scale = 1.4826;
+};  // namespace
+
+hampel::hampel(size_t w, double t) : window{w}, threshold{t}, tree(levels + 1) {
+	if (!window)
+		throw std::runtime_error("Filter window should not be empty");
+	if (window > std::numeric_limits<uint16_t>::max())
+		throw std::runtime_error(fmt::format("Filter window {} should be at most {}", window, std::numeric_limits<uint16_t>::max()));
+	if (threshold < 0)
+		throw std::runtime_error(fmt::format("Filter threshold {} should not be negative", threshold));
+	ring.reserve(window);
+}
+
+uint64_t hampel::add(uint64_t value) {
+	const auto level = static_cast<uint16_t>(std::min<uint64_t>(value, levels - 1));
+	if (ring.size() < window) {
+		ring.push_back(level);
+	} else {
+		count(ring[next], -1);
+		ring[next] = level;
+		next = (next + 1) % ring.size();
+	}
+	count(level, 1);
+
+	const int64_t m2 = double_median();
+	const double m = m2 / 2.0;
+	if (threshold > 0) {
+		// median absolute deviation
+		const size_t n = ring.size();
+		const double d = n % 2 ? double_distance(m2, n / 2) / 2.0
+		                       : (double_distance(m2, n / 2 - 1) + double_distance(m2, n / 2)) / 4.0;
+		if (std::abs(value - m) <= threshold * mad_scale * d)
+			return value;
+	}
+
+	return static_cast<uint64_t>(std::lround(m));
+}
+
+void hampel::count(size_t value, int delta) {
+	for (size_t i = value + 1; i <= levels; i += i & -i)
+		tree[i] += delta;
+}
+
+size_t hampel::up_to(int64_t value) const {
+	size_t result = 0;
+	for (auto i = static_cast<size_t>(std::clamp<int64_t>(value + 1, 0, levels)); i; i -= i & -i)
+		result += tree[i];
+	return result;
+}
+
+// descends the tree, skipping whole subtrees with fewer samples than left to skip
+size_t hampel::nth(size_t rank) const {
+	size_t pos = 0;
+	for (size_t step = levels; step; step /= 2) {
+		if (pos + step <= levels && tree[pos + step] <= rank) {
+			pos += step;
+			rank -= tree[pos];
+		}
+	}
+	return pos;
+}
+
+int64_t hampel::double_median() const {
+	const size_t n = ring.size();
+	return n % 2 ? 2 * static_cast<int64_t>(nth(n / 2)) : static_cast<int64_t>(nth(n / 2 - 1) + nth(n / 2));
+}
+
+// the smallest distance with more than rank samples as close to the median
+int64_t hampel::double_distance(int64_t m2, size_t rank) const {
+	int64_t low = 0;
+	int64_t high = 2 * levels;
+	while (low < high) {
+		const int64_t d = (low + high) / 2;
+		// x with m2 - d <= 2x <= m2 + d
+		const int64_t from = m2 - d > 0 ? (m2 - d + 1) / 2 : 0;
+		if (up_to((m2 + d) / 2) - up_to(from - 1) > rank)
+			high = d;
+		else
+			low = d + 1;
+	}
+	return low;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Rolling median over the last samples, kept as a ring in arrival order and
+ * counts per value in a Fenwick tree. With a threshold it is a Hampel filter:
+ * a sample further than threshold robust standard deviations (1.4826 MAD)
+ * from the median is replaced by it, other samples pass unchanged. Without
+ * one every sample is replaced by the median.
+ *
+ * The median is found in log(levels) steps and the MAD by a binary search
+ * over distances, log(levels) squared, whatever the window. Values are
+ * counted as at most levels - 1, that is 1638.3 ug/m3 in SDS011 units, past
+ * its range of 999.9.
+ */
+class hampel {
+ public:
+	hampel(size_t window, double threshold);
+
+	// filtered value of that sample
+	[[nodiscard]] uint64_t add(uint64_t);
+
+	static constexpr size_t levels = 1 << 14;
+
+ private:
+	size_t window;
+	std::vector<uint16_t> ring;
+	size_t next = 0;
+	double threshold;
+	// counts of samples per value, a window fits into 16 bits
+	std::vector<uint16_t> tree;
+
+	void count(size_t value, int delta);
+
+	// samples up to the value
+	[[nodiscard]] size_t up_to(int64_t value) const;
+
+	// 0-based
+	[[nodiscard]] size_t nth(size_t rank) const;
+
+	// in halves, the median may fall between two values
+	[[nodiscard]] int64_t double_median() const;
+	[[nodiscard]] int64_t double_distance(int64_t double_median, size_t rank) const;
+};
@@ -0,0 +1,50 @@
+#include "humidity.hpp"
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+// g/cm3, of the ammonium sulfate and nitrate dominated dry aerosol
+constexpr double particle_density = 1.65;
+// growth explodes towards saturation, where the correction is no longer meaningful
+constexpr double max_water_activity = 0.95;
+
+std::chrono::nanoseconds distance(humidity_correction::clock::time_point a, humidity_correction::clock::time_point b) {
+	return a > b ? a - b : b - a;
+}
+};  // namespace
+
+humidity_correction::humidity_correction(double k, clock::duration s) : kappa{k}, skew{s} {
+	if (kappa <= 0)
+		throw std::runtime_error(fmt::format("Hygroscopicity {} should be positive", kappa));
+}
+
+void humidity_correction::climate(uint64_t deca_humidity, clock::time_point at) {
+	previous = latest;
+	latest = sample{deca_humidity, at};
+}
+
+void humidity_correction::particulates(const sds011::data& data, clock::time_point at) {
+	pm = data;
+	pm_at = at;
+}
+
+void humidity_correction::emit(record& rec) {
+	if (!pm)
+		return;
+
+	const sample* closest = nullptr;
+	for (const auto& candidate : {&previous, &latest})
+		if (*candidate && distance((*candidate)->at, pm_at) <= skew && (!closest || distance((*candidate)->at, pm_at) < distance(closest->at, pm_at)))
+			closest = &**candidate;
+
+	if (closest) {
+		const double aw = std::min(closest->deca_humidity / 1000.0, max_water_activity);
+		const double growth = 1 + kappa / particle_density * aw / (1 - aw);
+		rec.add("deca_pm25_corrected", static_cast<int64_t>(std::llround(pm->deca_pm25 / growth)));
+		rec.add("deca_pm10_corrected", static_cast<int64_t>(std::llround(pm->deca_pm10 / growth)));
+	}
+	pm.reset();
+}
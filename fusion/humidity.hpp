@@ -0,0 +1,45 @@
+#pragma once
+
+#include "../record/record.hpp"
+#include "../sds011/sds011.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+/*
+ * The SDS011 counts water on hygroscopic particles as mass. Its readings are
+ * paired with the closest humidity reading of bme280 or bme680, before or
+ * after it, and corrected by kappa-Koehler growth (Crilley et al. 2018):
+ * dry = wet / (1 + kappa / density * aw / (1 - aw)), aw being relative
+ * humidity as a fraction.
+ */
+class humidity_correction {
+ public:
+	using clock = std::chrono::steady_clock;
+
+	humidity_correction(double kappa, clock::duration skew);
+
+	void climate(uint64_t deca_humidity, clock::time_point);
+
+	void particulates(const sds011::data&, clock::time_point);
+
+	// adds deca_pm25_corrected and deca_pm10_corrected if the last particulates have a humidity within the skew
+	void emit(record&);
+
+ private:
+	struct sample {
+		uint64_t deca_humidity;
+		clock::time_point at;
+	};
+
+	double kappa;
+	clock::duration skew;
+
+	// the two newest, so that a reading taken between them finds either
+	std::optional<sample> previous;
+	std::optional<sample> latest;
+
+	std::optional<sds011::data> pm;
+	clock::time_point pm_at;
+};
@@ -0,0 +1,227 @@
+#include "history.hpp"
+#include "../logger/logger.hpp"
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <variant>
+#include <vector>
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+constexpr auto poll_interval = std::chrono::milliseconds(200);
+constexpr auto client_timeout = std::chrono::seconds(2);
+constexpr size_t max_request = 256;
+
+int64_t now_ms() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+int64_t parse_number(std::string_view str, std::string_view what) {
+	int64_t result{};
+	if (auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), result); ec != std::errc{} || end != str.data() + str.size())
+		throw std::runtime_error(fmt::format("Failed to parse {} '{}'", what, str));
+	return result;
+}
+
+int64_t parse_time(std::string_view str, std::string_view what) {
+	const auto result = parse_number(str, what);
+	return result > 0 ? result : now_ms() + result;
+}
+
+std::vector<std::string_view> words(std::string_view line) {
+	std::vector<std::string_view> result;
+	while (!line.empty()) {
+		const auto start = line.find_first_not_of(" \t\r\n");
+		if (start == std::string_view::npos)
+			break;
+		line.remove_prefix(start);
+		const auto end = std::min(line.find_first_of(" \t\r\n"), line.size());
+		result.push_back(line.substr(0, end));
+		line.remove_prefix(end);
+	}
+	return result;
+}
+};  // namespace
+
+history::history(std::chrono::hours r, const std::string& path) : retention{r}, socket_path{path} {
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path))
+		throw std::runtime_error(fmt::format("Socket path '{}' is too long", path));
+	memcpy(addr.sun_path, path.c_str(), path.size());
+
+	if (fh = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0); fh < 0)
+		throw std::runtime_error(fmt::format("Failed to create socket: {}", strerror(errno)));
+
+	// a socket left behind by a previous run
+	unlink(path.c_str());
+	if (bind(fh, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fh, 4) < 0) {
+		const int error = errno;
+		close(fh);
+		throw std::runtime_error(fmt::format("Failed to listen on '{}': {}", path, strerror(error)));
+	}
+
+	server = std::thread{[this] { serve(); }};
+}
+
+history::~history() {
+	stopping.store(true, std::memory_order_release);
+	server.join();
+	close(fh);
+	unlink(socket_path.c_str());
+}
+
+void history::add(const record& rec, std::chrono::system_clock::time_point at) {
+	const auto t = std::chrono::duration_cast<std::chrono::milliseconds>(at.time_since_epoch()).count();
+
+	std::lock_guard guard{lock};
+	for (const auto& f : rec.fields) {
+		auto it = fields.find(f.key);
+		if (it == fields.end())
+			it = fields.emplace(std::string{f.key}, series{}).first;
+		it->second.add(t, std::visit([](auto v) { return static_cast<double>(v); }, f.val));
+		it->second.expire(t - retention.count());
+	}
+}
+
+void history::serve() {
+	// signals are for the main loop, to cut its wait short
+	sigset_t all;
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, nullptr);
+
+	while (!stopping.load(std::memory_order_acquire)) {
+		pollfd fd{.fd = fh, .events = POLLIN, .revents = 0};
+		if (poll(&fd, 1, static_cast<int>(poll_interval.count())) <= 0)
+			continue;
+
+		const int client = accept4(fh, nullptr, nullptr, SOCK_CLOEXEC);
+		if (client < 0)
+			continue;
+
+		// a stuck client only holds up other clients
+		const timeval timeout{.tv_sec = client_timeout.count(), .tv_usec = 0};
+		setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+		answer(client);
+		close(client);
+	}
+}
+
+void history::answer(int client) {
+	char request[max_request];
+	size_t received = 0;
+	while (received < sizeof(request)) {
+		const auto bytes = read(client, request + received, sizeof(request) - received);
+		if (bytes <= 0)
+			return;
+		received += bytes;
+		if (std::find(request, request + received, '\n') != request + received)
+			break;
+	}
+
+	std::string response;
+	try {
+		response = query({request, static_cast<size_t>(std::find(request, request + received, '\n') - request)});
+	} catch (const std::exception& e) {
+		// the message may quote the request
+		response = "{\"error\":\"";
+		escape_json(e.what(), response);
+		response += "\"}";
+	}
+	response += '\n';
+
+	for (size_t sent = 0; sent < response.size();) {
+		const auto bytes = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+		if (bytes <= 0) {
+			logger::print(logger::warning, "Failed to answer history query: {}", strerror(errno));
+			return;
+		}
+		sent += bytes;
+	}
+}
+
+std::string history::query(std::string_view request) {
+	const auto w = words(request);
+	std::string out;
+	auto it = std::back_inserter(out);
+
+	if (w.size() == 1 && w[0] == "fields") {
+		std::lock_guard guard{lock};
+		out = "{\"fields\":{";
+		const char* separator = "";
+		for (const auto& [key, s] : fields) {
+			fmt::format_to(it, "{}\"{}\":{{\"points\":{},\"bytes\":{}}}", separator, key, s.points(), s.bytes());
+			separator = ",";
+		}
+		out += "}}";
+		return out;
+	}
+
+	if (w.empty() || w[0] != "range" || w.size() < 4 || w.size() > 5)
+		throw std::runtime_error("Expected 'fields' or 'range <field> <from> <to> [<step>]'");
+
+	const auto from = parse_time(w[2], "from");
+	const auto to = parse_time(w[3], "to");
+	const int64_t step = w.size() == 5 ? parse_number(w[4], "step") : 0;
+	if (step < 0)
+		throw std::runtime_error("Step should not be negative");
+
+	// a copy is a few hundred KB at most, the probes don't wait for the points to be formatted
+	series points;
+	{
+		std::lock_guard guard{lock};
+		const auto s = fields.find(w[1]);
+		if (s == fields.end())
+			throw std::runtime_error(fmt::format("Unknown field '{}'", w[1]));
+		points = s->second;
+	}
+
+	fmt::format_to(it, "{{\"field\":\"{}\",\"points\":[", w[1]);
+	const char* separator = "";
+	if (!step) {
+		points.scan(from, to, [&](int64_t t, double v) {
+			fmt::format_to(it, "{}[{},{}]", separator, t, v);
+			separator = ",";
+		});
+	} else {
+		int64_t bucket = std::numeric_limits<int64_t>::min();
+		double sum = 0, low = 0, high = 0;
+		size_t count = 0;
+		const auto flush = [&] {
+			if (count) {
+				fmt::format_to(it, "{}[{},{},{},{}]", separator, bucket, sum / count, low, high);
+				separator = ",";
+			}
+		};
+		points.scan(from, to, [&](int64_t t, double v) {
+			const auto start = from + (t - from) / step * step;
+			if (start != bucket) {
+				flush();
+				bucket = start;
+				sum = 0;
+				count = 0;
+				low = high = v;
+			}
+			sum += v;
+			low = std::min(low, v);
+			high = std::max(high, v);
+			++count;
+		});
+		flush();
+	}
+	out += "]}";
+	return out;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "../record/record.hpp"
+#include "series.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+/*
+ * Every field of every probe for the last hours, compressed in memory, and a
+ * Unix socket to ask for it. A client sends one line and gets one line of
+ * json back:
+ *
+ *   fields                                 {"fields":{"co2":{"points":..,"bytes":..},..}}
+ *   range <field> <from> <to> [<step>]     {"field":"co2","points":[[t,value],..]}
+ *
+ * Times are unix milliseconds, zero or negative ones are relative to now,
+ * e.g. "range co2 -3600000 0 60000" is the last hour. With a step the points
+ * are summarized per step as [t,mean,min,max].
+ *
+ * Queries are answered by a thread of their own, decompressing a day of
+ * points never delays a probe.
+ */
+class history {
+ public:
+	history(std::chrono::hours retention, const std::string& socket_path);
+	explicit history(history&&) = delete;
+
+	~history();
+
+	// at realtime
+	void add(const record&, std::chrono::system_clock::time_point);
+
+ private:
+	std::chrono::milliseconds retention;
+	std::string socket_path;
+	int fh;
+
+	std::mutex lock;
+	// keys are copied, aggregated fields point into their aggregator
+	std::map<std::string, series, std::less<>> fields;
+
+	std::atomic<bool> stopping{false};
+	std::thread server;
+
+	void serve();
+
+	void answer(int client);
+
+	std::string query(std::string_view request);
+};
@@ -0,0 +1,172 @@
+#include "series.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// a timestamp of up to 4 + 64 bits and a value of up to 2 + 5 + 6 + 64 bits
+constexpr size_t max_point_bits = 145;
+
+uint64_t bits_of(double value) {
+	uint64_t result;
+	memcpy(&result, &value, sizeof(result));
+	return result;
+}
+
+double from_bits(uint64_t bits) {
+	double result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+int64_t sign_extend(uint64_t value, int bits) {
+	const auto shift = 64 - bits;
+	return static_cast<int64_t>(value << shift) >> shift;
+}
+};  // namespace
+
+series::block::block() : words(block_words) {}
+
+// most significant bit first
+void series::block::write(uint64_t value, int n) {
+	if (n < 64)
+		value &= (uint64_t{1} << n) - 1;
+	const int free = 64 - static_cast<int>(bits % 64);
+	if (n <= free) {
+		words[bits / 64] |= value << (free - n);
+	} else {
+		words[bits / 64] |= value >> (n - free);
+		words[bits / 64 + 1] |= value << (64 - (n - free));
+	}
+	bits += n;
+}
+
+uint64_t series::block::reader::read(int n) {
+	const size_t offset = pos % 64;
+	uint64_t result = b.words[pos / 64] << offset;
+	if (offset + n > 64)
+		result |= b.words[pos / 64 + 1] >> (64 - offset);
+	pos += n;
+	return n < 64 ? result >> (64 - n) : result;
+}
+
+bool series::block::add(int64_t t, double v) {
+	if (bits + max_point_bits > block_words * 64)
+		return false;
+
+	const uint64_t value = bits_of(v);
+	if (!count) {
+		first_t = last_t = t;
+		write(value, 64);
+		last_value = value;
+		++count;
+		return true;
+	}
+
+	const int64_t delta = t - last_t;
+	const int64_t dod = delta - last_delta;
+	// two's complement ranges of the fields, not the paper's [-63, 64] which decodes 64 as -64
+	if (dod == 0) {
+		write(0b0, 1);
+	} else if (dod >= -64 && dod <= 63) {
+		write(0b10, 2);
+		write(dod, 7);
+	} else if (dod >= -256 && dod <= 255) {
+		write(0b110, 3);
+		write(dod, 9);
+	} else if (dod >= -2048 && dod <= 2047) {
+		write(0b1110, 4);
+		write(dod, 12);
+	} else {
+		write(0b1111, 4);
+		write(dod, 64);
+	}
+	last_delta = delta;
+	last_t = t;
+
+	const uint64_t x = value ^ last_value;
+	last_value = value;
+	if (!x) {
+		write(0b0, 1);
+	} else {
+		const int lead = std::min(__builtin_clzll(x), 31);
+		const int trail = __builtin_ctzll(x);
+		if (leading >= 0 && lead >= leading && trail >= trailing) {
+			// fits into the window of the previous value
+			write(0b10, 2);
+			write(x >> trailing, 64 - leading - trailing);
+		} else {
+			leading = lead;
+			trailing = trail;
+			const int meaningful = 64 - lead - trail;
+			write(0b11, 2);
+			write(lead, 5);
+			// 64 does not fit into 6 bits, 0 can't happen
+			write(meaningful & 63, 6);
+			write(x >> trail, meaningful);
+		}
+	}
+
+	++count;
+	return true;
+}
+
+std::pair<int64_t, double> series::block::reader::next(uint32_t index) {
+	if (!index) {
+		t = b.first_t;
+		value = read(64);
+		return {t, from_bits(value)};
+	}
+
+	int64_t dod;
+	if (!read(1))
+		dod = 0;
+	else if (!read(1))
+		dod = sign_extend(read(7), 7);
+	else if (!read(1))
+		dod = sign_extend(read(9), 9);
+	else if (!read(1))
+		dod = sign_extend(read(12), 12);
+	else
+		dod = static_cast<int64_t>(read(64));
+	delta += dod;
+	t += delta;
+
+	if (read(1)) {
+		if (read(1)) {
+			leading = static_cast<int>(read(5));
+			int meaningful = static_cast<int>(read(6));
+			if (!meaningful)
+				meaningful = 64;
+			trailing = 64 - leading - meaningful;
+		}
+		value ^= read(64 - leading - trailing) << trailing;
+	}
+	return {t, from_bits(value)};
+}
+
+void series::add(int64_t t, double value) {
+	if (!blocks.empty())
+		t = std::max(t, blocks.back().last_t);
+	if (blocks.empty() || !blocks.back().add(t, value)) {
+		// an empty block always has room
+		blocks.emplace_back();
+		static_cast<void>(blocks.back().add(t, value));
+	}
+}
+
+void series::expire(int64_t t) {
+	while (!blocks.empty() && blocks.front().last_t < t)
+		blocks.pop_front();
+}
+
+size_t series::bytes() const {
+	return blocks.size() * block_words * sizeof(uint64_t);
+}
+
+size_t series::points() const {
+	size_t result = 0;
+	for (const auto& b : blocks)
+		result += b.count;
+	return result;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+/*
+ * Time series compressed as in Facebook's Gorilla (Pelkonen et al. 2015):
+ * timestamps as delta of delta, usually a single bit for a steady rate, and
+ * values as the XOR with the previous one, usually a few bits for a slowly
+ * moving reading. Points go into fixed-size blocks, so expiring old points is
+ * dropping whole blocks and memory is bounded by the number of blocks.
+ */
+class series {
+ public:
+	// milliseconds, an earlier one than the last point's is taken as that, the
+	// wall clock steps back now and then and the points have to stay in order
+	void add(int64_t t, double value);
+
+	// oldest first, f(t, value) for every point in [from, to]
+	template <typename F>
+	void scan(int64_t from, int64_t to, F&& f) const {
+		for (const auto& b : blocks)
+			if (b.last_t >= from && b.first_t <= to)
+				b.scan(from, to, f);
+	}
+
+	// drops blocks whose points are all older than t
+	void expire(int64_t t);
+
+	[[nodiscard]] size_t bytes() const;
+
+	[[nodiscard]] size_t points() const;
+
+	static constexpr size_t block_words = 256;
+
+ private:
+	class block {
+	 public:
+		int64_t first_t = 0;
+		int64_t last_t = 0;
+		uint32_t count = 0;
+
+		block();
+
+		// false if the point might not fit
+		[[nodiscard]] bool add(int64_t t, double value);
+
+		template <typename F>
+		void scan(int64_t from, int64_t to, F& f) const {
+			reader r{*this};
+			for (uint32_t i = 0; i < count; ++i) {
+				const auto [t, value] = r.next(i);
+				if (t > to)
+					break;
+				if (t >= from)
+					f(t, value);
+			}
+		}
+
+	 private:
+		std::vector<uint64_t> words;
+		size_t bits = 0;
+
+		int64_t last_delta = 0;
+		uint64_t last_value = 0;
+		int leading = -1;
+		int trailing = 0;
+
+		void write(uint64_t value, int count);
+
+		struct reader {
+			const block& b;
+			size_t pos = 0;
+			int64_t t = 0;
+			int64_t delta = 0;
+			uint64_t value = 0;
+			int leading = 0;
+			int trailing = 0;
+
+			uint64_t read(int count);
+			std::pair<int64_t, double> next(uint32_t index);
+		};
+	};
+
+	std::deque<block> blocks;
+};
@@ -0,0 +1,207 @@
+#include "i2c.hpp"
+#include "../capture/capture.hpp"
+
+#include <fcntl.h>
+#include <linux/i2c-dev.h>
+#include <linux/i2c.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+size_t reply_size(capture::op what) {
+	switch (what) {
+		case capture::op::i2c_read8:
+		case capture::op::i2c_read_reg8:
+			return 1;
+		case capture::op::i2c_read_reg16:
+			return 2;
+		default:
+			return 0;
+	}
+}
+};  // namespace
+
+namespace i2c {
+device::device(const std::string& path, uint8_t address) : fd{::open(path.c_str(), O_RDWR)} {
+	if (fd < 0)
+		throw std::runtime_error(fmt::format("Failed to open '{}': {}", path, strerror(errno)));
+
+	if (ioctl(fd, I2C_SLAVE, address) < 0) {
+		close(fd);
+		throw std::runtime_error(fmt::format("Failed to select 0x{:x} on '{}': {}", address, path, strerror(errno)));
+	}
+}
+
+device::~device() {
+	close(fd);
+}
+
+uint16_t device::transfer(char direction, uint8_t command, int size, uint16_t value) {
+	i2c_smbus_data data;
+	data.word = value;
+
+	i2c_smbus_ioctl_data args;
+	args.read_write = direction;
+	args.command = command;
+	args.size = size;
+	args.data = &data;
+
+	++transactions;
+	if (ioctl(fd, I2C_SMBUS, &args) < 0)
+		throw std::runtime_error(fmt::format("I2C transfer failed: {}", strerror(errno)));
+
+	return size == I2C_SMBUS_WORD_DATA ? data.word : data.byte;
+}
+
+uint8_t device::read8() {
+	return transfer(I2C_SMBUS_READ, 0, I2C_SMBUS_BYTE);
+}
+
+void device::write8(uint8_t reg) {
+	// the register goes out as the command byte, there is no data
+	transfer(I2C_SMBUS_WRITE, reg, I2C_SMBUS_BYTE);
+}
+
+uint8_t device::read_reg8(uint8_t reg) {
+	return transfer(I2C_SMBUS_READ, reg, I2C_SMBUS_BYTE_DATA);
+}
+
+uint16_t device::read_reg16(uint8_t reg) {
+	return transfer(I2C_SMBUS_READ, reg, I2C_SMBUS_WORD_DATA);
+}
+
+void device::write_reg8(uint8_t reg, uint8_t value) {
+	transfer(I2C_SMBUS_WRITE, reg, I2C_SMBUS_BYTE_DATA, value);
+}
+
+recorder::recorder(std::unique_ptr<bus> b, capture::writer& w, uint16_t c) : inner{std::move(b)}, out{w}, channel{c} {}
+
+void recorder::add(capture::op what, std::initializer_list<uint8_t> data) {
+	++transactions;
+	out.add(channel, what, 0, data.begin(), data.size());
+}
+
+void recorder::add_failure(capture::op what, std::initializer_list<uint8_t> request) {
+	++transactions;
+	out.add(channel, what, -(errno ? errno : EIO), request.begin(), request.size());
+}
+
+uint8_t recorder::read8() {
+	try {
+		const auto value = inner->read8();
+		add(capture::op::i2c_read8, {value});
+		return value;
+	} catch (...) {
+		add_failure(capture::op::i2c_read8, {});
+		throw;
+	}
+}
+
+void recorder::write8(uint8_t reg) {
+	try {
+		inner->write8(reg);
+		add(capture::op::i2c_write8, {reg});
+	} catch (...) {
+		add_failure(capture::op::i2c_write8, {reg});
+		throw;
+	}
+}
+
+uint8_t recorder::read_reg8(uint8_t reg) {
+	try {
+		const auto value = inner->read_reg8(reg);
+		add(capture::op::i2c_read_reg8, {reg, value});
+		return value;
+	} catch (...) {
+		add_failure(capture::op::i2c_read_reg8, {reg});
+		throw;
+	}
+}
+
+uint16_t recorder::read_reg16(uint8_t reg) {
+	try {
+		const auto value = inner->read_reg16(reg);
+		add(capture::op::i2c_read_reg16, {reg, uint8_t(value), uint8_t(value >> 8)});
+		return value;
+	} catch (...) {
+		add_failure(capture::op::i2c_read_reg16, {reg});
+		throw;
+	}
+}
+
+void recorder::write_reg8(uint8_t reg, uint8_t value) {
+	try {
+		inner->write_reg8(reg, value);
+		add(capture::op::i2c_write_reg8, {reg, value});
+	} catch (...) {
+		add_failure(capture::op::i2c_write_reg8, {reg, value});
+		throw;
+	}
+}
+
+player::player(capture::reader& r, uint16_t c) : in{r}, channel{c} {}
+
+std::string_view player::replay(capture::op what, std::initializer_list<uint8_t> request) {
+	++transactions;
+	const auto& e = in.next(channel, what, {reinterpret_cast<const char*>(request.begin()), request.size()});
+	if (e.result < 0)
+		throw std::runtime_error(fmt::format("I2C transfer failed: {}", strerror(-e.result)));
+	if (e.data.size() < request.size() + reply_size(what))
+		throw std::runtime_error("I2C replay is truncated");
+	return e.data.substr(request.size());
+}
+
+uint8_t player::read8() {
+	return replay(capture::op::i2c_read8, {})[0];
+}
+
+void player::write8(uint8_t reg) {
+	(void)replay(capture::op::i2c_write8, {reg});
+}
+
+uint8_t player::read_reg8(uint8_t reg) {
+	return replay(capture::op::i2c_read_reg8, {reg})[0];
+}
+
+uint16_t player::read_reg16(uint8_t reg) {
+	const auto reply = replay(capture::op::i2c_read_reg16, {reg});
+	return uint8_t(reply[0]) | (uint8_t(reply[1]) << 8);
+}
+
+void player::write_reg8(uint8_t reg, uint8_t value) {
+	(void)replay(capture::op::i2c_write_reg8, {reg, value});
+}
+
+std::string channel(const std::string& path, uint8_t address) {
+	return fmt::format("{}@0x{:x}", path, address);
+}
+
+std::unique_ptr<bus> open(const std::string& path, uint8_t address) {
+	const auto name = channel(path, address);
+	if (auto* replay = capture::reader::active) {
+		const auto id = replay->channel(name);
+		if (const auto& e = replay->next(id, capture::op::open); e.result < 0)
+			throw std::runtime_error(fmt::format("Failed to open '{}': {}", path, strerror(-e.result)));
+		return std::make_unique<player>(*replay, id);
+	}
+
+	auto* record = capture::writer::active;
+	if (!record)
+		return std::make_unique<device>(path, address);
+
+	const auto id = record->channel(name);
+	try {
+		auto result = std::make_unique<device>(path, address);
+		record->add(id, capture::op::open, 0, nullptr, 0);
+		return std::make_unique<recorder>(std::move(result), *record, id);
+	} catch (...) {
+		record->add(id, capture::op::open, -(errno ? errno : EIO), nullptr, 0);
+		throw;
+	}
+}
+};  // namespace i2c
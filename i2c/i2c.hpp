@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace capture {
+enum class op : uint8_t;
+class writer;
+class reader;
+};  // namespace capture
+
+namespace i2c {
+// SMBus style transactions the drivers need, one call is one bus transaction
+class bus {
+ public:
+	virtual ~bus() = default;
+
+	// byte at the register pointer, which the chip then advances
+	[[nodiscard]] virtual uint8_t read8() = 0;
+	// only sets the register pointer
+	virtual void write8(uint8_t reg) = 0;
+	[[nodiscard]] virtual uint8_t read_reg8(uint8_t reg) = 0;
+	// low byte first, as SMBus read word
+	[[nodiscard]] virtual uint16_t read_reg16(uint8_t reg) = 0;
+	virtual void write_reg8(uint8_t reg, uint8_t value) = 0;
+
+	uint64_t transactions = 0;
+};
+
+// chip behind a linux i2c-dev adapter, e.g. /dev/i2c-1
+class device : public bus {
+ public:
+	device(const std::string& path, uint8_t address);
+	device(const device&) = delete;
+
+	~device() override;
+
+	[[nodiscard]] uint8_t read8() override;
+	void write8(uint8_t reg) override;
+	[[nodiscard]] uint8_t read_reg8(uint8_t reg) override;
+	[[nodiscard]] uint16_t read_reg16(uint8_t reg) override;
+	void write_reg8(uint8_t reg, uint8_t value) override;
+
+ private:
+	uint16_t transfer(char direction, uint8_t command, int size, uint16_t value = 0);
+
+	int fd;
+};
+
+// passes everything through and writes it to the capture
+class recorder : public bus {
+ public:
+	recorder(std::unique_ptr<bus>, capture::writer&, uint16_t channel);
+
+	[[nodiscard]] uint8_t read8() override;
+	void write8(uint8_t reg) override;
+	[[nodiscard]] uint8_t read_reg8(uint8_t reg) override;
+	[[nodiscard]] uint16_t read_reg16(uint8_t reg) override;
+	void write_reg8(uint8_t reg, uint8_t value) override;
+
+ private:
+	void add(capture::op, std::initializer_list<uint8_t> data);
+	// after the inner bus threw
+	void add_failure(capture::op, std::initializer_list<uint8_t> request);
+
+	std::unique_ptr<bus> inner;
+	capture::writer& out;
+	uint16_t channel;
+};
+
+// answers from a capture instead of a chip
+class player : public bus {
+ public:
+	player(capture::reader&, uint16_t channel);
+
+	[[nodiscard]] uint8_t read8() override;
+	void write8(uint8_t reg) override;
+	[[nodiscard]] uint8_t read_reg8(uint8_t reg) override;
+	[[nodiscard]] uint16_t read_reg16(uint8_t reg) override;
+	void write_reg8(uint8_t reg, uint8_t value) override;
+
+ private:
+	// recorded reply bytes after the request
+	std::string_view replay(capture::op, std::initializer_list<uint8_t> request);
+
+	capture::reader& in;
+	uint16_t channel;
+};
+
+// how the chip is named in captures
+[[nodiscard]] std::string channel(const std::string& path, uint8_t address);
+
+// chip at path and address, or its recording while capture::reader::active, recorded while capture::writer::active
+[[nodiscard]] std::unique_ptr<bus> open(const std::string& path, uint8_t address);
+};  // namespace i2c
@@ -0,0 +1,203 @@
+#include "logger.hpp"
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <signal.h>
+
+logger* logger::active = nullptr;
+
+namespace {
+int syslog_priority(logger::severity level) {
+	switch (level) {
+		case logger::debug:
+			return 7;
+		case logger::info:
+			return 6;
+		case logger::warning:
+			return 4;
+		case logger::error:
+			return 3;
+	}
+	return 6;
+}
+};  // namespace
+
+logger::logger(const config& c, FILE* o)
+    : cfg{c}, out{o}, journal{getenv("JOURNAL_STREAM") != nullptr}, ring{new line[c.capacity]}, head{0}, tail{0}, dropped{0}, stopping{false} {
+	if (!cfg.capacity)
+		throw std::runtime_error("Log ring can't be empty");
+
+	for (size_t i = 0; i < cfg.capacity; ++i)
+		ring[i].ready.store(0, std::memory_order_relaxed);
+
+	writer = std::thread{[this] { run(); }};
+}
+
+logger::~logger() {
+	if (active == this)
+		active = nullptr;
+
+	stopping.store(true, std::memory_order_release);
+	writer.join();
+
+	drain(std::chrono::steady_clock::now());
+	for (auto& [site, state] : sites)
+		summarize(state);
+	fflush(out);
+}
+
+logger::severity logger::parse_severity(const std::string& name) {
+	if (name == "debug")
+		return debug;
+	if (name == "info")
+		return info;
+	if (name == "warning")
+		return warning;
+	if (name == "error")
+		return error;
+	throw std::runtime_error(fmt::format("Unknown log level '{}'", name));
+}
+
+void logger::dump(std::string_view text) {
+	if (active && active->cfg.threshold == debug)
+		active->push(debug, nullptr, text.data(), text.size());
+}
+
+size_t logger::slots(size_t size) const {
+	return std::clamp<size_t>((size + line_size - 1) / line_size, 1, std::max<size_t>(cfg.capacity / 4, 1));
+}
+
+void logger::push(severity level, const char* site, const char* text, size_t size) {
+	const size_t count = slots(size);
+	auto idx = head.load(std::memory_order_relaxed);
+	do {
+		if (idx + count - tail.load(std::memory_order_acquire) > cfg.capacity) {
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	} while (!head.compare_exchange_weak(idx, idx + count, std::memory_order_relaxed));
+
+	const bool cut = size > count * line_size;
+	for (size_t i = 0; i < count; ++i) {
+		auto& l = ring[(idx + i) % cfg.capacity];
+		const size_t offset = i * line_size;
+		l.level = level;
+		l.site = site;
+		l.more = i ? 0 : count - 1;
+		l.size = std::min(size - offset, line_size);
+		memcpy(l.text, text + offset, l.size);
+		if (cut && i == count - 1)
+			memcpy(l.text + line_size - 3, "...", 3);
+		l.ready.store(idx + i + 1, std::memory_order_release);
+	}
+}
+
+void logger::run() {
+	// signals are for the main loop, to cut its wait short
+	sigset_t all;
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, nullptr);
+
+	while (!stopping.load(std::memory_order_acquire)) {
+		std::this_thread::sleep_for(cfg.flush_every);
+		drain(std::chrono::steady_clock::now());
+	}
+}
+
+void logger::drain(std::chrono::steady_clock::time_point now) {
+	auto idx = tail.load(std::memory_order_relaxed);
+	for (;; ++idx) {
+		const auto& l = ring[idx % cfg.capacity];
+		// claimed but not written yet, it is picked up next time
+		if (l.ready.load(std::memory_order_acquire) != idx + 1)
+			break;
+
+		if (!l.more) {
+			handle(l.level, l.site, {l.text, l.size}, now);
+		} else {
+			bool complete = true;
+			for (size_t i = 1; i <= l.more && complete; ++i)
+				complete = ring[(idx + i) % cfg.capacity].ready.load(std::memory_order_acquire) == idx + i + 1;
+			if (!complete)
+				break;
+
+			joined.clear();
+			for (size_t i = 0; i <= l.more; ++i) {
+				const auto& part = ring[(idx + i) % cfg.capacity];
+				joined.append(part.text, part.size);
+			}
+			handle(l.level, l.site, joined, now);
+			idx += l.more;
+		}
+		tail.store(idx + 1, std::memory_order_release);
+	}
+
+	for (auto& [site, state] : sites) {
+		if (now - state.window_start >= cfg.window) {
+			summarize(state);
+			state.window_start = now;
+		}
+	}
+
+	if (const auto lost = dropped.exchange(0, std::memory_order_relaxed))
+		write(warning, fmt::format("Log ring was full, {} lines dropped", lost));
+
+	fflush(out);
+}
+
+void logger::handle(severity level, const char* site, std::string_view view, std::chrono::steady_clock::time_point now) {
+	// asked for explicitly and meant to be verbose
+	if (level == debug) {
+		write(level, view);
+		return;
+	}
+
+	const std::string text{view};
+	auto [it, fresh] = sites.try_emplace(site);
+	auto& state = it->second;
+	if (fresh)
+		state.window_start = now;
+	state.level = level;
+
+	if (auto seen = state.repeated.find(text); seen != state.repeated.end()) {
+		++seen->second;
+		return;
+	}
+
+	if (state.written >= cfg.burst) {
+		++state.suppressed;
+		state.last_suppressed = text;
+		return;
+	}
+	++state.written;
+	state.repeated.emplace(text, 0);
+	write(level, text);
+}
+
+void logger::summarize(site_state& state) {
+	// a line that did not come again is forgotten, it is written in full once it does
+	for (auto it = state.repeated.begin(); it != state.repeated.end();) {
+		if (!it->second) {
+			it = state.repeated.erase(it);
+			continue;
+		}
+		write(state.level, fmt::format("Repeated {} times: {}", it->second, it->first));
+		it->second = 0;
+		++it;
+	}
+	if (state.suppressed)
+		write(state.level, fmt::format("{} more lines like this were suppressed: {}", state.suppressed, state.last_suppressed));
+	state.suppressed = 0;
+	state.written = state.repeated.size();
+}
+
+void logger::write(severity level, std::string_view text) {
+	if (journal)
+		fmt::print(out, "<{}>{}\n", syslog_priority(level), text);
+	else
+		fmt::print(out, "{}\n", text);
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+/*
+ * Log lines go into a lock-free ring and a background thread writes them out,
+ * so a slow stderr, e.g. journald under load, never stalls a probe. Lines that
+ * don't fit into the ring are dropped and counted, longer than line_size are cut
+ * and end in "...". Longer text, e.g. a whole record, goes out by dump in
+ * consecutive slots, up to a quarter of the ring.
+ *
+ * The writer lets through at most burst distinct lines per window for every
+ * call site and counts the rest. A line that was already written is only
+ * counted too, the counts are written when the window is over, so a sensor
+ * that stays unplugged costs one line per window. Call sites are told apart
+ * by their format string. Debug lines are neither counted nor suppressed.
+ *
+ * Without an active logger lines are printed right away, as before.
+ */
+class logger {
+ public:
+	enum severity { debug, info, warning, error };
+
+	struct config {
+		severity threshold = info;
+		size_t capacity = 256;
+		size_t burst = 5;
+		std::chrono::seconds window{60};
+		std::chrono::milliseconds flush_every{50};
+	};
+
+	explicit logger(const config&, FILE* out = stderr);
+	explicit logger(logger&&) = delete;
+
+	// writes what is left, summaries included
+	~logger();
+
+	template <typename... Args>
+	static void print(severity level, fmt::format_string<Args...> format, Args&&... args) {
+		if (!active) {
+			if (level >= info) {
+				fmt::print(stderr, format, std::forward<Args>(args)...);
+				fputc('\n', stderr);
+			}
+			return;
+		}
+		if (level < active->cfg.threshold)
+			return;
+
+		char text[line_size];
+		const auto size = fmt::format_to_n(text, sizeof(text), format, std::forward<Args>(args)...).size;
+		if (size > sizeof(text))
+			memcpy(text + sizeof(text) - 3, "...", 3);
+		active->push(level, fmt::string_view{format}.data(), text, std::min(size, sizeof(text)));
+	}
+
+	// debug text longer than a line, never blocks either
+	static void dump(std::string_view text);
+
+	[[nodiscard]] static severity parse_severity(const std::string&);
+
+	static logger* active;
+
+ private:
+	static constexpr size_t line_size = 240;
+
+	struct line {
+		std::atomic<uint64_t> ready;
+		severity level;
+		const char* site;
+		uint16_t size;
+		// slots after this one that continue its text
+		uint16_t more;
+		char text[line_size];
+	};
+
+	// per call site, only touched by the writer thread
+	struct site_state {
+		std::chrono::steady_clock::time_point window_start;
+		size_t written = 0;
+		uint64_t suppressed = 0;
+		std::string last_suppressed;
+		severity level = info;
+		// lines already written and how often they came again since
+		std::unordered_map<std::string, uint64_t> repeated;
+	};
+
+	// never blocks, drops the line if the ring is full
+	void push(severity, const char* site, const char* text, size_t size);
+
+	// the slots of text longer than line_size, consecutive in the ring
+	[[nodiscard]] size_t slots(size_t size) const;
+
+	void run();
+	void drain(std::chrono::steady_clock::time_point now);
+	void handle(severity, const char* site, std::string_view text, std::chrono::steady_clock::time_point now);
+	void summarize(site_state&);
+	void write(severity, std::string_view text);
+
+	config cfg;
+	FILE* out;
+	// journald takes <N> prefixes as the syslog priority of a line
+	bool journal;
+	std::unique_ptr<line[]> ring;
+	std::atomic<uint64_t> head;
+	std::atomic<uint64_t> tail;
+	std::atomic<uint64_t> dropped;
+	std::atomic<bool> stopping;
+	std::unordered_map<const char*, site_state> sites;
+	// text of a line that took several slots, only touched by the writer thread
+	std::string joined;
+	std::thread writer;
+};
@@ -1,40 +1,83 @@
+#include "aggregate/aggregate.hpp"
+#include "aqi/aqi.hpp"
 #include "bme280/bme280.hpp"
 #include "bme680/bme680.hpp"
+#include "calibration/calibration.hpp"
+#include "burst/burst.hpp"
+#include "capture/capture.hpp"
+#include "deadband/deadband.hpp"
+#include "errors/errors.hpp"
+#include "filter/hampel.hpp"
+#include "fusion/humidity.hpp"
+#include "history/history.hpp"
+#include "i2c/i2c.hpp"
+#include "logger/logger.hpp"
+#include "metrics/exporter.hpp"
+#include "metrics/stats.hpp"
+#include "perf/perf.hpp"
+#include "record/record.hpp"
 #include "s8/s8.hpp"
+#include "schedule/adaptive.hpp"
 #include "sds011/sds011.hpp"
-#include "udp/udpclient.hpp"
+#include "shm/publisher.hpp"
+#include "snapshot/snapshot.hpp"
+#include "sink/destination.hpp"
+#include "trace/tracer.hpp"
 
 #include "lib/cxxopts.hpp"
 
 #include <fmt/core.h>
 #include <chrono>
+#include <csignal>
+#include <ctime>
+#include <deque>
 #include <exception>
 #include <iostream>
 #include <optional>
 #include <string>
 #include <thread>
 #include <type_traits>
+#include <variant>
+#include <vector>
 
 namespace {
-void init_handler(auto& h) {
+volatile std::sig_atomic_t dump_requested = 0;
+volatile std::sig_atomic_t stop_requested = 0;
+
+// set once in main when tracing
+tracer* tracing = nullptr;
+
+void request_dump(int) {
+	dump_requested = 1;
+}
+
+void request_stop(int) {
+	stop_requested = 1;
+}
+
+void init_handler(auto& h, sensor_stats& st, const auto&... args) {
 	if (!h) {
+		tracer::span span{tracing, st.name, "init"};
 		try {
-			h.emplace();
+			h.emplace(args...);
 		} catch (const std::exception& e) {
-			fmt::print(stderr, "Failed to init: {}\n", e.what());
+			logger::print(logger::error, "Failed to init {}: {}", st.name, e.what());
 			h.reset();
+			++st.init_failures;
 		}
 	}
 }
 
-void init_handler(auto& h, auto&& init) requires std::is_rvalue_reference_v<decltype(init)> {
+void init_handler(auto& h, sensor_stats& st, auto&& init, const auto&... args) requires std::is_rvalue_reference_v<decltype(init)> {
 	if (!h) {
+		tracer::span span{tracing, st.name, "init"};
 		try {
-			h.emplace();
+			h.emplace(args...);
 			init(h);
 		} catch (const std::exception& e) {
-			fmt::print(stderr, "Failed to init: {}\n", e.what());
+			logger::print(logger::error, "Failed to init {}: {}", st.name, e.what());
 			h.reset();
+			++st.init_failures;
 		}
 	}
 }
@@ -44,20 +87,31 @@ void print_data(auto& h) {
 		try {
 			h->print_data();
 		} catch (const std::exception& e) {
-			fmt::print(stderr, "Failed to print data: {}\n", e.what());
+			logger::print(logger::error, "Failed to print data: {}", e.what());
 			h.reset();
 		}
 	}
 }
 
-void add_data(auto& h, auto&& adder) requires std::is_rvalue_reference_v<decltype(adder)> {
+void add_data(auto& h, sensor_stats& st, auto&& adder) requires std::is_rvalue_reference_v<decltype(adder)> {
 	if (h) {
 		try {
+			const auto started = std::chrono::steady_clock::now();
 			const auto data = h->get_data();
-			adder(data);
+			const auto finished = std::chrono::steady_clock::now();
+			st.latency.record(finished - started);
+			if (tracing)
+				tracing->add(st.name, "read", started, finished);
+			++st.reads;
+			adder(data, snapshot::acquisition{finished, std::chrono::system_clock::now()});
 		} catch (const std::exception& e) {
-			fmt::print(stderr, "Failed to add data: {}\n", e.what());
+			logger::print(logger::error, "Failed to add data of {}: {}", st.name, e.what());
 			h.reset();
+			++st.read_failures;
+			if (dynamic_cast<const crc_error*>(&e))
+				++st.crc_failures;
+			else if (dynamic_cast<const short_read_error*>(&e))
+				++st.short_reads;
 		}
 	}
 }
@@ -67,17 +121,99 @@ int main(int argc, char** argv) {
 	cxxopts::Options options("air", "Air quality");
 
 	uint interval = 0;
+	uint interval_ms = 0;
+	uint sample_ms = 0;
+	uint adaptive_ms = 0;
+	double adaptive_threshold = 0.02;
+	std::vector<std::string> deadband_specs;
+	std::vector<std::string> trigger_specs;
+	size_t burst_before = 60;
+	size_t burst_after = 30;
+	uint burst_ms = 0;
+	std::string history_path;
+	uint history_hours = 24;
+	bool timestamps = false;
+	uint heartbeat = 600;
+	size_t pm_filter = 0;
+	double pm_filter_threshold = 3;
+	bool pm_raw = false;
+	bool with_aqi = false;
+	double kappa = 0;
+	uint humidity_skew_ms = 5000;
 	bool json = false;
 	std::string name;
 	std::string receiver_host;
 	ushort receiver_port;
+	std::string spool_path;
+	size_t spool_size = 4 << 20;
+	uint spool_rate = 10;
+	bool nack = false;
+	size_t window_size = 256;
+	std::vector<std::string> destination_specs;
+	std::string shm_name;
+	ushort metrics_port = 0;
+	uint stats_every = 0;
+	std::string trace_path;
+	bool perf_counters = false;
+	std::string s8_path{s8::default_path};
+	std::string sds011_path{sds011::default_path};
+	std::string bme280_path{bme280::default_path};
+	std::string bme680_path{bme680::default_path};
+	std::string calibration_path;
+	std::string record_path;
+	std::string replay_path;
+	bool replay_fast = false;
+	std::string log_level{"info"};
+	logger::config log_config;
+	uint log_window = log_config.window.count();
 
 	options.add_options()
 		("i,interval", "sleep time between probes", cxxopts::value<uint>(interval))
+		("interval-ms", "sleep time between probes in milliseconds, instead of --interval", cxxopts::value<uint>(interval_ms))
+		("sample-ms", "probe that often in milliseconds and report min, max, mean, std and p95 of every field once per interval, requires json format", cxxopts::value<uint>(sample_ms))
+		("adaptive-min", "read each sensor as often as every that many milliseconds while its readings are volatile and back off to the interval when they are calm, requires json format", cxxopts::value<uint>(adaptive_ms))
+		("adaptive-threshold", "standard deviation relative to the mean above which readings count as volatile", cxxopts::value<double>(adaptive_threshold))
+		("deadband", "only report when a field moves out of its band around the value last reported, as key=N or key=N%, may be repeated, requires json format", cxxopts::value<std::vector<std::string>>(deadband_specs))
+		("heartbeat", "seconds after which an unchanged report is sent anyway", cxxopts::value<uint>(heartbeat))
+		("calibration", "file with offset, gain and curve corrections per sensor and field", cxxopts::value<std::string>(calibration_path))
+		("pm-filter", "rolling median of that many SDS011 readings, 0 to report them unfiltered", cxxopts::value<size_t>(pm_filter))
+		("pm-filter-threshold", "only replace readings further than that many robust standard deviations from the median (Hampel filter), 0 to always report the median", cxxopts::value<double>(pm_filter_threshold))
+		("pm-raw", "report unfiltered, but calibrated, SDS011 readings too, as deca_pm25_raw and deca_pm10_raw", cxxopts::value<bool>(pm_raw))
+		("aqi", "add US EPA AQI and NowCast of PM2.5 and PM10, from hourly averages kept for a day", cxxopts::value<bool>(with_aqi))
+		("kappa", "hygroscopicity of the particles, adds PM corrected for water uptake at the humidity measured closest in time, e.g. 0.4, 0 to leave it out", cxxopts::value<double>(kappa))
+		("humidity-skew", "milliseconds between a PM and a humidity reading to still pair them", cxxopts::value<uint>(humidity_skew_ms))
+		("burst-trigger", "send the probes around the moment a field exceeds a value, key>N, or rose by that much within the probes kept, key+N, as one record; may be repeated, requires json format", cxxopts::value<std::vector<std::string>>(trigger_specs))
+		("burst-before", "probes kept to send from before a trigger", cxxopts::value<size_t>(burst_before))
+		("burst-after", "probes to send from after a trigger", cxxopts::value<size_t>(burst_after))
+		("burst-ms", "probe that often in milliseconds while collecting the probes after a trigger, reports still follow the interval; probes before a trigger are taken at the interval or --sample-ms", cxxopts::value<uint>(burst_ms))
+		("history", "keep every probe in memory and answer queries for it on that Unix socket, requires json format", cxxopts::value<std::string>(history_path))
+		("history-hours", "hours of probes kept", cxxopts::value<uint>(history_hours))
+		("timestamps", "add when each reading was taken, its age and the skew between readings to every record", cxxopts::value<bool>(timestamps))
 		("j,json", "response in json", cxxopts::value<bool>(json))
 		("n,name", "name of that sender, required for sending", cxxopts::value<std::string>(name))
 		("h,host", "receiver host address, requires name, port and json format", cxxopts::value<std::string>(receiver_host))
 		("p,port", "receiver port, requires name, host and json format", cxxopts::value<ushort>(receiver_port))
+		("s,spool", "file to keep records in while receiver is unreachable, requires host and port", cxxopts::value<std::string>(spool_path))
+		("spool-size", "spool file size in bytes", cxxopts::value<size_t>(spool_size))
+		("spool-rate", "max spooled records to replay per probe", cxxopts::value<uint>(spool_rate))
+		("nack", "resend records the receiver reports lost, requires host and port", cxxopts::value<bool>(nack))
+		("window", "number of last records kept for resending", cxxopts::value<size_t>(window_size))
+		("d,destination", "additional receiver as [udp://|tcp://]host:port or unix://path, then [?format=json|influx][&batch=N][&spool=file][&nack=window], may be repeated, nack over udp only; batched records are one per line, over udp only as many as fit into 1400 bytes, none waits longer than the interval, requires name and json format", cxxopts::value<std::vector<std::string>>(destination_specs))
+		("shm", "publish latest readings in shared memory under that name, e.g. /air, requires json format", cxxopts::value<std::string>(shm_name))
+		("metrics-port", "serve OpenMetrics on that port, requires interval and json format", cxxopts::value<ushort>(metrics_port))
+		("stats-every", "add latency and error statistics to every Nth json record", cxxopts::value<uint>(stats_every))
+		("trace", "write spans of every probe phase to that file in Chrome trace-event format", cxxopts::value<std::string>(trace_path))
+		("perf", "count cycles, instructions, cache misses and context switches of encode, parse, compensation and send", cxxopts::value<bool>(perf_counters))
+		("s8-path", "serial device of the S8, empty to leave it out", cxxopts::value<std::string>(s8_path))
+		("sds011-path", "serial device of the SDS011, empty to leave it out", cxxopts::value<std::string>(sds011_path))
+		("bme280-path", "I2C adapter of the bme280, which is only probed when given", cxxopts::value<std::string>(bme280_path))
+		("bme680-path", "file with bme680 readings, empty to leave it out; when given, the bundled fetcher is not started", cxxopts::value<std::string>(bme680_path))
+		("record", "write raw serial and I2C traffic of the sensors to that file", cxxopts::value<std::string>(record_path))
+		("replay", "feed the drivers from a file written by --record instead of the sensors, stops at its end", cxxopts::value<std::string>(replay_path))
+		("replay-fast", "replay as fast as possible instead of with the recorded timing", cxxopts::value<bool>(replay_fast))
+		("log-level", "least severity logged: debug, which includes every record sent, info, warning or error", cxxopts::value<std::string>(log_level))
+		("log-burst", "lines logged per place in the code and window, the rest is only counted", cxxopts::value<size_t>(log_config.burst))
+		("log-window", "seconds of the log rate limit window", cxxopts::value<uint>(log_window))
 		("help", "Print help");
 
 	auto result = options.parse(argc, argv);
@@ -92,12 +228,14 @@ int main(int argc, char** argv) {
 		exit(0);
 	}
 
-	if (receiver_port && name.empty()) {
+	const bool sending = receiver_port || !destination_specs.empty();
+
+	if (sending && name.empty()) {
 		fmt::print("Name should be specified with receiver.\n{}\n", options.help({""}));
 		exit(0);
 	}
 
-	if (receiver_port && !json) {
+	if (sending && !json) {
 		fmt::print("Currently can send only as json, please specify --json.\n{}\n", options.help({""}));
 		exit(0);
 	}
@@ -107,65 +245,604 @@ int main(int argc, char** argv) {
 		exit(0);
 	}
 
+	if (!spool_path.empty() && !receiver_port) {
+		fmt::print("Spool requires receiver.\n{}\n", options.help({""}));
+		exit(0);
+	}
+
+	if (nack && !sending) {
+		fmt::print("Nack requires receiver.\n{}\n", options.help({""}));
+		exit(0);
+	}
+
+	if (nack && !window_size) {
+		fmt::print("Window should not be empty.\n{}\n", options.help({""}));
+		exit(0);
+	}
+
+	if (!shm_name.empty() && !json) {
+		fmt::print("Shared memory is only published with --json.\n{}\n", options.help({""}));
+		exit(0);
+	}
+
+	const std::chrono::milliseconds period = interval_ms ? std::chrono::milliseconds(interval_ms) : std::chrono::seconds(interval);
+
+	if (metrics_port && (!json || !period.count())) {
+		fmt::print("Metrics are only served with --json and --interval.\n{}\n", options.help({""}));
+		exit(0);
+	}
+
+	if (sample_ms && (!json || std::chrono::milliseconds(sample_ms) >= period)) {
+		fmt::print("Sampling requires --json and should be more frequent than the interval.\n{}\n", options.help({""}));
+		exit(0);
+	}
+
+	if (adaptive_ms && (!json || sample_ms || std::chrono::milliseconds(adaptive_ms) >= period)) {
+		fmt::print("Adaptive sampling requires --json, can't be combined with --sample-ms and its minimum should be below the interval.\n{}\n", options.help({""}));
+		exit(0);
+	}
+
+	if (!history_path.empty() && !json) {
+		fmt::print("History requires --json.\n{}\n", options.help({""}));
+		exit(0);
+	}
+
+	if (!trigger_specs.empty() && !json) {
+		fmt::print("Burst requires --json.\n{}\n", options.help({""}));
+		exit(0);
+	}
+
+	if (burst_ms && (trigger_specs.empty() || sample_ms || adaptive_ms || std::chrono::milliseconds(burst_ms) >= period)) {
+		fmt::print("Burst pace requires --burst-trigger, can't be combined with --sample-ms or --adaptive-min and should be more frequent than the interval.\n{}\n", options.help({""}));
+		exit(0);
+	}
+
+	if (!deadband_specs.empty() && !json) {
+		fmt::print("Deadband requires --json.\n{}\n", options.help({""}));
+		exit(0);
+	}
+
+	if (!record_path.empty() && !replay_path.empty()) {
+		fmt::print("Can't record and replay at the same time.\n{}\n", options.help({""}));
+		exit(0);
+	}
+
+	std::optional<logger> logging;
+
+	try {
+		log_config.threshold = logger::parse_severity(log_level);
+		log_config.window = std::chrono::seconds(log_window);
+		logging.emplace(log_config);
+		logger::active = &*logging;
+	} catch (const std::exception& e) {
+		fmt::print(stderr, "Failed to set up logging: {}\n", e.what());
+		exit(1);
+	}
+
+	// someone else, e.g. an emulator, keeps the file up to date
+	const bool bme680_fetcher = !result.count("bme680-path");
+
+	std::optional<capture::writer> recording;
+	std::optional<capture::reader> replay;
+
+	try {
+		if (!record_path.empty()) {
+			recording.emplace(record_path);
+			capture::writer::active = &*recording;
+		}
+		if (!replay_path.empty()) {
+			replay.emplace(replay_path, !replay_fast);
+			capture::reader::active = &*replay;
+		}
+	} catch (const std::exception& e) {
+		fmt::print(stderr, "Failed to open capture: {}\n", e.what());
+		exit(1);
+	}
+
+	// a replay has only the sensors it recorded, bme680 is a file and never recorded
+	const bool with_s8 = replay ? replay->has(s8_path) : !s8_path.empty();
+	const bool with_sds011 = replay ? replay->has(sds011_path) : !sds011_path.empty();
+	const bool with_bme280 = replay ? replay->has(i2c::channel(bme280_path, bme280::address)) : result.count("bme280-path") > 0;
+	const bool with_bme680 = !replay && !bme680_path.empty();
+
 	std::optional<s8> s8h;
 	std::optional<sds011> sds011h;
-	// std::optional<bme280> bme280h;
+	std::optional<bme280> bme280h;
 	std::optional<bme680> bme680h;
 
-	std::optional<udpclient> client;
+	// destinations are neither copied nor moved, deque keeps them in place
+	std::deque<destination> destinations;
+
+	try {
+		destination::config defaults;
+		defaults.spool_size = spool_size;
+		defaults.spool_rate = spool_rate;
+		defaults.window = nack ? window_size : 0;
+		// a record waits in a batch for an interval at most
+		defaults.batch_age = period;
+
+		if (receiver_port) {
+			auto primary = defaults;
+			primary.host = receiver_host;
+			primary.port = receiver_port;
+			primary.spool = spool_path;
+			destinations.emplace_back(std::move(primary));
+		}
+
+		for (const auto& spec : destination_specs)
+			destinations.emplace_back(destination::config::parse(spec, defaults));
+	} catch (const std::exception& e) {
+		fmt::print(stderr, "Failed to set up destination: {}\n", e.what());
+		exit(1);
+	}
+
+	std::optional<adaptive_interval> s8_rate;
+	std::optional<adaptive_interval> sds011_rate;
+	std::optional<adaptive_interval> bme280_rate;
+	std::optional<adaptive_interval> bme680_rate;
+
+	if (adaptive_ms) {
+		try {
+			for (auto [rate, with] : {std::pair{&s8_rate, with_s8}, {&sds011_rate, with_sds011}, {&bme280_rate, with_bme280}, {&bme680_rate, with_bme680}})
+				if (with)
+					rate->emplace(std::chrono::milliseconds(adaptive_ms), period, adaptive_threshold);
+		} catch (const std::exception& e) {
+			fmt::print(stderr, "Failed to set up adaptive sampling: {}\n", e.what());
+			exit(1);
+		}
+	}
+
+	std::optional<burst> bursts;
+
+	if (!trigger_specs.empty()) {
+		try {
+			std::vector<burst::trigger> triggers;
+			for (const auto& spec : trigger_specs)
+				triggers.push_back(burst::trigger::parse(spec));
+			bursts.emplace(std::move(triggers), burst_before, burst_after);
+		} catch (const std::exception& e) {
+			fmt::print(stderr, "Failed to set up burst: {}\n", e.what());
+			exit(1);
+		}
+	}
+
+	std::optional<history> archive;
+
+	if (!history_path.empty()) {
+		try {
+			archive.emplace(std::chrono::hours(history_hours), history_path);
+		} catch (const std::exception& e) {
+			fmt::print(stderr, "Failed to set up history: {}\n", e.what());
+			exit(1);
+		}
+	}
+
+	std::optional<deadband> band;
+
+	if (!deadband_specs.empty()) {
+		try {
+			std::vector<deadband::band> bands;
+			for (const auto& spec : deadband_specs)
+				bands.push_back(deadband::band::parse(spec));
+
+			// what a record of these sensors and options can carry when the deadband looks at it
+			std::vector<std::string> fields;
+			if (with_s8)
+				fields.push_back("co2");
+			if (with_sds011) {
+				fields.insert(fields.end(), {"deca_pm25", "deca_pm10"});
+				if (pm_raw)
+					fields.insert(fields.end(), {"deca_pm25_raw", "deca_pm10_raw"});
+				if (with_aqi)
+					fields.insert(fields.end(), {"deca_pm25_nowcast", "aqi_pm25_nowcast", "deca_pm25_24h", "aqi_pm25", "deca_pm10_nowcast",
+					                             "aqi_pm10_nowcast", "deca_pm10_24h", "aqi_pm10"});
+				if (kappa)
+					fields.insert(fields.end(), {"deca_pm25_corrected", "deca_pm10_corrected"});
+			}
+			if (with_bme280 || with_bme680)
+				fields.insert(fields.end(), {"deca_humidity", "deca_kelvin"});
+			if (with_bme680)
+				fields.push_back("gas");
+			if (sample_ms)
+				for (size_t i = 0, n = fields.size(); i < n; ++i)
+					for (const auto* suffix : {"_min", "_max", "_mean", "_std", "_p95"})
+						fields.push_back(fields[i] + suffix);
+
+			band.emplace(std::move(bands), std::chrono::seconds(heartbeat), fields);
+		} catch (const std::exception& e) {
+			fmt::print(stderr, "Failed to set up deadband: {}\n", e.what());
+			exit(1);
+		}
+	}
+
+	std::optional<calibration> calibrated;
+
+	if (!calibration_path.empty()) {
+		try {
+			calibrated.emplace(calibration::load(calibration_path));
+		} catch (const std::exception& e) {
+			fmt::print(stderr, "Failed to load calibration: {}\n", e.what());
+			exit(1);
+		}
+	}
+
+	std::optional<hampel> pm25_filter;
+	std::optional<hampel> pm10_filter;
+
+	if (pm_filter) {
+		try {
+			pm25_filter.emplace(pm_filter, pm_filter_threshold);
+			pm10_filter.emplace(pm_filter, pm_filter_threshold);
+		} catch (const std::exception& e) {
+			fmt::print(stderr, "Failed to set up filter: {}\n", e.what());
+			exit(1);
+		}
+	}
+
+	std::optional<aqi::monitor> quality;
+	if (with_aqi)
+		quality.emplace();
+
+	std::optional<humidity_correction> correction;
+
+	if (kappa) {
+		try {
+			correction.emplace(kappa, std::chrono::milliseconds(humidity_skew_ms));
+		} catch (const std::exception& e) {
+			fmt::print(stderr, "Failed to set up humidity correction: {}\n", e.what());
+			exit(1);
+		}
+	}
+
+	std::optional<publisher> board;
+
+	if (!shm_name.empty()) {
+		try {
+			board.emplace(shm_name);
+		} catch (const std::exception& e) {
+			fmt::print(stderr, "Failed to open shared memory: {}\n", e.what());
+			exit(1);
+		}
+	}
+
+	stats health;
+
+	// SIGUSR1 dumps statistics to stderr. Sensor reads and writes are restarted, but the wait in
+	// nanosleep or poll is not, whatever SA_RESTART says, so the signal still cuts it short.
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_flags = SA_RESTART;
+	action.sa_handler = request_dump;
+	sigaction(SIGUSR1, &action, nullptr);
+
+	// leave the loop cleanly, so that devices are restored, trace and spool are flushed and batches sent
+	action.sa_handler = request_stop;
+	sigaction(SIGINT, &action, nullptr);
+	sigaction(SIGTERM, &action, nullptr);
+
+	std::optional<perf::counters> hardware;
+
+	if (perf_counters) {
+		try {
+			hardware.emplace();
+		} catch (const std::exception& e) {
+			fmt::print(stderr, "Failed to open perf counters: {}\n", e.what());
+			exit(1);
+		}
+	}
+
+	std::optional<tracer> trace;
+
+	if (!trace_path.empty()) {
+		try {
+			trace.emplace(trace_path);
+			tracing = &*trace;
+		} catch (const std::exception& e) {
+			fmt::print(stderr, "Failed to open trace: {}\n", e.what());
+			exit(1);
+		}
+	}
+	std::optional<exporter> scraper;
+
+	if (metrics_port) {
+		try {
+			scraper.emplace(metrics_port, name, health, destinations);
+		} catch (const std::exception& e) {
+			fmt::print(stderr, "Failed to start metrics: {}\n", e.what());
+			exit(1);
+		}
+	}
+
+	// seq restarts with the process, run tells the receiver which sequence it belongs to
+	const auto run = std::time(nullptr);
+	uint64_t seq = 0;
+
+	record rec;
+	record burst_rec;
+	snapshot taken;
+	std::optional<aggregator> window;
+	// probes per report
+	uint64_t samples = 1;
+	uint64_t sampled = 0;
+	uint64_t reports = 0;
+	if (sample_ms) {
+		window.emplace();
+		samples = period / std::chrono::milliseconds(sample_ms);
+	}
+	const auto pace = window ? std::chrono::milliseconds(sample_ms) : period;
+	// probes taken at the burst pace in between are only for the burst
+	std::chrono::steady_clock::time_point next_report;
+	// one buffer per format, shared by all destinations using it
+	std::string encoded[2];
+
+	const auto transmit = [&](record& r) {
+		r.name = name;
+		if (sending) {
+			r.run = run;
+			r.seq = seq;
+		}
+
+		for (auto& buffer : encoded)
+			buffer.clear();
+
+		if (sending) {
+			{
+				tracer::span span{tracing, "encode", "main"};
+				perf::region region{perf::stage::encode};
+				for (auto& d : destinations) {
+					auto& buffer = encoded[static_cast<size_t>(d.encoding())];
+					if (buffer.empty())
+						encode(r, d.encoding(), buffer);
+				}
+			}
+			logger::dump(encoded[static_cast<size_t>(destinations.front().encoding())]);
+
+			for (auto& d : destinations) {
+				tracer::span span{tracing, d.statistics().name, "send"};
+				d.push(seq, encoded[static_cast<size_t>(d.encoding())]);
+				d.serve_nacks();
+			}
+			++seq;
+		} else {
+			{
+				tracer::span span{tracing, "encode", "main"};
+				perf::region region{perf::stage::encode};
+				encode(r, format::json, encoded[0]);
+			}
+			fmt::print("{}\n", encoded[0]);
+		}
+	};
 
 	do {
-		init_handler(s8h);
+		tracer::span cycle{tracing, "cycle", "main"};
+		++health.cycles;
+
+		if (with_s8)
+			init_handler(s8h, health.s8, s8_path);
 
-		init_handler(sds011h, [](auto& h) {
-			h->set_sleep(false);
-			h->set_working_period(0);
-			h->set_mode(1);
-		});
+		if (with_sds011)
+			init_handler(
+			    sds011h, health.sds011,
+			    [](auto& h) {
+				    h->set_sleep(false);
+				    h->set_working_period(0);
+				    h->set_mode(1);
+			    },
+			    sds011_path);
 
-		// init_handler(bme280h);
-		init_handler(bme680h);
+		if (with_bme280)
+			init_handler(bme280h, health.bme280, bme280_path);
+		if (with_bme680)
+			init_handler(bme680h, health.bme680, bme680_path, bme680_fetcher);
 
 		if (json) {
-			std::string result{fmt::format("{{\"name\":\"{}\"", name)};
-			add_data(s8h, [&result](const auto& data) mutable { result += fmt::format(",\"co2\":{}", data.co2); });
-			add_data(sds011h, [&result](const auto& data) mutable { result += fmt::format(",\"deca_pm25\":{},\"deca_pm10\":{}", data.deca_pm25, data.deca_pm10); });
-			// add_data(bme280h, [&result](const auto& data) mutable {
-			// 	result += fmt::format(",\"deca_humidity\":{},\"deca_kelvin\":{}", data.deca_humidity, data.deca_kelvin);
-			// });
-			add_data(bme680h, [&result](const auto& data) mutable {
-				result += fmt::format(",{}", data.data);
-			});
-			result += "}";
-
-			if (receiver_port) {
-				fmt::print(stderr, "{}\n", result);
-
-				init_handler(client, [&receiver_host, receiver_port](auto& h) { h->connect(receiver_host, receiver_port); });
-
-				if (client) {
-					try {
-						client->send(result);
-					} catch (const std::exception& e) {
-						fmt::print(stderr, "Failed to send data: {}\n", e.what());
-						client.reset();
+			rec.clear();
+			taken.clear();
+
+			// with adaptive sampling a sensor is only read when its turn has come
+			const auto probe_time = std::chrono::steady_clock::now();
+			const auto turn = [probe_time](std::optional<adaptive_interval>& rate) {
+				if (!rate)
+					return true;
+				if (!rate->due(probe_time))
+					return false;
+				rate->probed(probe_time);
+				return true;
+			};
+
+			if (turn(s8_rate))
+				add_data(s8h, health.s8, [&](auto data, const auto& at) {
+					if (calibrated)
+						calibrated->apply(data);
+					if (s8_rate)
+						s8_rate->update({static_cast<double>(data.co2)}, at.monotonic);
+					if (board)
+						board->publish(data);
+					if (scraper)
+						scraper->update(data);
+					rec.add("co2", static_cast<int64_t>(data.co2));
+					if (timestamps)
+						taken.add("s8", at);
+				});
+			if (turn(sds011_rate))
+				add_data(sds011h, health.sds011, [&](auto raw, const auto& at) {
+					if (calibrated)
+						calibrated->apply(raw);
+					if (sds011_rate)
+						sds011_rate->update({static_cast<double>(raw.deca_pm25), static_cast<double>(raw.deca_pm10)}, at.monotonic);
+					auto data = raw;
+					if (pm25_filter) {
+						data.deca_pm25 = pm25_filter->add(raw.deca_pm25);
+						data.deca_pm10 = pm10_filter->add(raw.deca_pm10);
+					}
+					if (board)
+						board->publish(data);
+					if (scraper)
+						scraper->update(data);
+					rec.add("deca_pm25", static_cast<int64_t>(data.deca_pm25));
+					rec.add("deca_pm10", static_cast<int64_t>(data.deca_pm10));
+					if (pm_raw) {
+						rec.add("deca_pm25_raw", static_cast<int64_t>(raw.deca_pm25));
+						rec.add("deca_pm10_raw", static_cast<int64_t>(raw.deca_pm10));
 					}
+					if (quality) {
+						quality->add(data, at.monotonic);
+						quality->emit(rec);
+					}
+					if (correction)
+						correction->particulates(data, at.monotonic);
+					if (timestamps)
+						taken.add("sds011", at);
+				});
+			if (turn(bme280_rate))
+				add_data(bme280h, health.bme280, [&](auto data, const auto& at) {
+					if (calibrated)
+						calibrated->apply(data);
+					if (bme280_rate)
+						bme280_rate->update({static_cast<double>(data.deca_humidity), static_cast<double>(data.deca_kelvin)}, at.monotonic);
+					if (correction)
+						correction->climate(data.deca_humidity, at.monotonic);
+					if (board)
+						board->publish(data);
+					if (scraper)
+						scraper->update(data);
+					rec.add("deca_humidity", static_cast<int64_t>(data.deca_humidity));
+					rec.add("deca_kelvin", static_cast<int64_t>(data.deca_kelvin));
+					if (timestamps)
+						taken.add("bme280", at);
+				});
+			if (turn(bme680_rate))
+				add_data(bme680h, health.bme680, [&](auto data, auto at) {
+					// taken when the fetcher wrote it, which may be a while ago
+					if (data.written) {
+						at.monotonic -= std::chrono::duration_cast<std::chrono::steady_clock::duration>(at.realtime - *data.written);
+						at.realtime = *data.written;
+					}
+					if (calibrated)
+						calibrated->apply(data);
+					if (bme680_rate)
+						bme680_rate->update({static_cast<double>(data.deca_humidity), static_cast<double>(data.deca_kelvin)}, at.monotonic);
+					if (correction)
+						correction->climate(data.deca_humidity, at.monotonic);
+					if (board)
+						board->publish(data);
+					if (scraper)
+						scraper->update(data);
+					rec.add("deca_humidity", static_cast<int64_t>(data.deca_humidity));
+					rec.add("deca_kelvin", static_cast<int64_t>(data.deca_kelvin));
+					if (data.gas)
+						rec.add("gas", *data.gas);
+					if (timestamps)
+						taken.add("bme680", at);
+				});
+
+			// humidity is read after the particulates, so this is the first chance to pair them
+			if (correction)
+				correction->emit(rec);
+
+			// individual probes, before they are summarized
+			if (archive)
+				archive->add(rec, std::chrono::system_clock::now());
+
+			if (bursts && bursts->add(rec, probe_time)) {
+				while (bursts->take(burst_rec)) {
+					transmit(burst_rec);
+					burst_rec.clear();
 				}
-			} else {
-				fmt::print("{}\n", result);
+			}
+
+			if (window)
+				for (const auto& f : rec.fields)
+					window->add(f.key, std::visit([](auto v) { return static_cast<double>(v); }, f.val));
+
+			// the last probe of a window carries its statistics next to the latest readings
+			// a turn without readings has nothing to report
+			bool reporting = (!window || ++sampled == samples) && !(adaptive_ms && rec.fields.empty());
+			if (burst_ms) {
+				if (probe_time < next_report)
+					reporting = false;
+				else
+					next_report = probe_time + period;
+			}
+			if (reporting && window) {
+				sampled = 0;
+				window->emit(rec);
+			}
+
+			// unchanged readings cost neither encoding nor a send, sensors not due keep their last values
+			if (reporting && band && !band->moved(rec, std::chrono::steady_clock::now(), adaptive_ms > 0)) {
+				reporting = false;
+				logger::print(logger::debug, "Readings within deadband, not reported");
+			}
+
+			if (reporting) {
+				++reports;
+
+				if (timestamps)
+					taken.emit(rec, snapshot::acquisition::now());
+
+				if (stats_every && reports % stats_every == 0) {
+					rec.json_extra = "\"stats\":";
+					dump_json(health, destinations, rec.json_extra);
+				}
+
+				transmit(rec);
 			}
 		} else {
 			print_data(s8h);
 			print_data(sds011h);
-			// print_data(bme280h);
+			print_data(bme280h);
 			print_data(bme680h);
 		}
 
-		if (interval) {
-			fmt::print(stderr, "---------------------------------------------\n");
-			std::this_thread::sleep_for(std::chrono::seconds(interval));
+		for (auto& d : destinations)
+			d.tick(std::chrono::steady_clock::now());
+
+		if (trace)
+			trace->flush();
+		if (recording)
+			recording->flush();
+
+		// the recorded timing paces a replay
+		if (period.count() && !replay && !stop_requested) {
+			logger::print(logger::debug, "---------------------------------------------");
+			tracer::span span{tracing, "wait", "main"};
+			auto deadline = std::chrono::steady_clock::now() + pace;
+			if (burst_ms)
+				deadline = bursts->collecting() ? std::chrono::steady_clock::now() + std::chrono::milliseconds(burst_ms)
+				                                : std::min(deadline, next_report);
+			for (const auto* rate : {&s8_rate, &sds011_rate, &bme280_rate, &bme680_rate})
+				if (*rate)
+					deadline = std::min(deadline, (*rate)->next());
+			for (auto now = std::chrono::steady_clock::now(); now < deadline && !stop_requested; now = std::chrono::steady_clock::now()) {
+				if (dump_requested) {
+					dump_requested = 0;
+					std::string dump;
+					dump_json(health, destinations, dump);
+					fmt::print(stderr, "{}\n", dump);
+					if (hardware) {
+						dump = "perf: ";
+						hardware->dump_json(dump);
+						fmt::print(stderr, "{}\n", dump);
+					}
+				}
+
+				if (scraper) {
+					scraper->serve_until(deadline);
+				} else {
+					const auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now).count();
+					const timespec ts{.tv_sec = static_cast<time_t>(left / 1000000000), .tv_nsec = static_cast<long>(left % 1000000000)};
+					nanosleep(&ts, nullptr);
+				}
+			}
 		}
-	} while (interval);
+	} while ((period.count() || replay) && !stop_requested && !(replay && replay->finished()));
+
+	if (hardware) {
+		std::string dump{"perf: "};
+		hardware->dump_json(dump);
+		fmt::print(stderr, "{}\n", dump);
+	}
 
 	return 0;
 }
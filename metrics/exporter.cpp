@@ -0,0 +1,295 @@
+#include "exporter.hpp"
+#include "../logger/logger.hpp"
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+constexpr double deca_kelvin_zero = 2731.5;
+constexpr auto client_timeout = std::chrono::seconds(5);
+
+constexpr std::string_view not_found =
+    "HTTP/1.1 404 Not Found\r\n"
+    "Content-Type: text/plain\r\n"
+    "Connection: close\r\n"
+    "Content-Length: 10\r\n\r\n"
+    "Not found\n";
+
+constexpr std::string_view too_large =
+    "HTTP/1.1 500 Internal Server Error\r\n"
+    "Content-Type: text/plain\r\n"
+    "Connection: close\r\n"
+    "Content-Length: 22\r\n\r\n"
+    "Metrics are too large\n";
+
+// appends to a fixed buffer, whatever does not fit is cut off and marks it full
+class writer {
+ public:
+	writer(char* b, size_t size) : begin{b}, pos{b}, end{b + size} {}
+
+	template <typename... T>
+	void operator()(fmt::format_string<T...> f, T&&... args) {
+		const auto result = fmt::format_to_n(pos, end - pos, f, std::forward<T>(args)...);
+		overflow |= result.size > static_cast<size_t>(end - pos);
+		pos = std::min(result.out, end);
+	}
+
+	size_t size() const {
+		return pos - begin;
+	}
+
+	bool full() const {
+		return overflow;
+	}
+
+ private:
+	char* begin;
+	char* pos;
+	char* end;
+	bool overflow = false;
+};
+
+void family(writer& w, std::string_view metric, std::string_view type, std::string_view help) {
+	w("# TYPE {} {}\n# HELP {} {}\n", metric, type, metric, help);
+}
+
+};  // namespace
+
+exporter::exporter(ushort port, std::string_view n, const stats& h, const std::deque<destination>& d)
+    : fh{socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)}, node{n}, health{h}, destinations{d} {
+	if (fh < 0)
+		throw std::runtime_error(fmt::format("Failed to create socket: {}", strerror(errno)));
+
+	try {
+		int on = 1, off = 0;
+		setsockopt(fh, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		// serve IPv4 scrapers as well
+		setsockopt(fh, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+
+		sockaddr_in6 addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin6_family = AF_INET6;
+		addr.sin6_addr = in6addr_any;
+		addr.sin6_port = htons(port);
+
+		if (bind(fh, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+			throw std::runtime_error(fmt::format("Failed to bind port {}: {}", port, strerror(errno)));
+
+		if (listen(fh, max_clients) < 0)
+			throw std::runtime_error(fmt::format("Failed to listen: {}", strerror(errno)));
+	} catch (...) {
+		close(fh);
+		throw;
+	}
+}
+
+exporter::~exporter() {
+	for (auto& c : clients)
+		drop(c);
+
+	close(fh);
+}
+
+void exporter::update(const s8::data& data) {
+	s8_latest = data;
+}
+
+void exporter::update(const sds011::data& data) {
+	sds011_latest = data;
+}
+
+void exporter::update(const bme280::data& data) {
+	bme280_latest = data;
+}
+
+void exporter::update(const bme680::data& data) {
+	bme680_latest = data;
+}
+
+std::optional<size_t> exporter::render() {
+	writer w{body, sizeof(body)};
+
+	if (s8_latest) {
+		family(w, "air_co2_ppm", "gauge", "CO2 concentration.");
+		w("air_co2_ppm{{node=\"{}\",sensor=\"s8\"}} {}\n", node, s8_latest->co2);
+	}
+
+	if (sds011_latest) {
+		family(w, "air_pm25_ugm3", "gauge", "PM2.5 concentration in ug/m3.");
+		w("air_pm25_ugm3{{node=\"{}\",sensor=\"sds011\"}} {}\n", node, sds011_latest->deca_pm25 / 10.0);
+		family(w, "air_pm10_ugm3", "gauge", "PM10 concentration in ug/m3.");
+		w("air_pm10_ugm3{{node=\"{}\",sensor=\"sds011\"}} {}\n", node, sds011_latest->deca_pm10 / 10.0);
+	}
+
+	if (bme280_latest || bme680_latest) {
+		family(w, "air_humidity_percent", "gauge", "Relative humidity.");
+		if (bme280_latest)
+			w("air_humidity_percent{{node=\"{}\",sensor=\"bme280\"}} {}\n", node, bme280_latest->deca_humidity / 10.0);
+		if (bme680_latest)
+			w("air_humidity_percent{{node=\"{}\",sensor=\"bme680\"}} {}\n", node, bme680_latest->deca_humidity / 10.0);
+
+		family(w, "air_temperature_celsius", "gauge", "Temperature.");
+		if (bme280_latest)
+			w("air_temperature_celsius{{node=\"{}\",sensor=\"bme280\"}} {}\n", node, (bme280_latest->deca_kelvin - deca_kelvin_zero) / 10.0);
+		if (bme680_latest)
+			w("air_temperature_celsius{{node=\"{}\",sensor=\"bme680\"}} {}\n", node, (bme680_latest->deca_kelvin - deca_kelvin_zero) / 10.0);
+	}
+
+	if (bme680_latest && bme680_latest->gas) {
+		family(w, "air_gas_resistance_ohms", "gauge", "Gas sensor resistance.");
+		w("air_gas_resistance_ohms{{node=\"{}\",sensor=\"bme680\"}} {}\n", node, *bme680_latest->gas);
+	}
+
+	family(w, "air_cycles", "counter", "Probes done.");
+	w("air_cycles_total{{node=\"{}\"}} {}\n", node, health.cycles);
+
+	const sensor_stats* sensors[] = {&health.s8, &health.sds011, &health.bme280, &health.bme680};
+	family(w, "air_sensor_reads", "counter", "Successful sensor reads.");
+	for (const auto* s : sensors)
+		w("air_sensor_reads_total{{node=\"{}\",sensor=\"{}\"}} {}\n", node, s->name, s->reads);
+	family(w, "air_sensor_read_failures", "counter", "Failed sensor reads.");
+	for (const auto* s : sensors)
+		w("air_sensor_read_failures_total{{node=\"{}\",sensor=\"{}\"}} {}\n", node, s->name, s->read_failures);
+	family(w, "air_sensor_init_failures", "counter", "Failed sensor initialisations.");
+	for (const auto* s : sensors)
+		w("air_sensor_init_failures_total{{node=\"{}\",sensor=\"{}\"}} {}\n", node, s->name, s->init_failures);
+
+	if (!destinations.empty()) {
+		family(w, "air_sink_sent", "counter", "Datagrams, or records over streams, fully sent.");
+		for (const auto& d : destinations)
+			w("air_sink_sent_total{{node=\"{}\",sink=\"{}\"}} {}\n", node, d.statistics().name, d.statistics().sent);
+		family(w, "air_sink_send_failures", "counter", "Failed sends.");
+		for (const auto& d : destinations)
+			w("air_sink_send_failures_total{{node=\"{}\",sink=\"{}\"}} {}\n", node, d.statistics().name, d.statistics().send_failures);
+		family(w, "air_sink_dropped", "counter", "Records given up on.");
+		for (const auto& d : destinations)
+			w("air_sink_dropped_total{{node=\"{}\",sink=\"{}\"}} {}\n", node, d.statistics().name, d.statistics().dropped);
+		family(w, "air_sink_connects", "counter", "Connections opened.");
+		for (const auto& d : destinations)
+			w("air_sink_connects_total{{node=\"{}\",sink=\"{}\"}} {}\n", node, d.statistics().name, d.statistics().connects);
+	}
+
+	w("# EOF\n");
+
+	if (w.full())
+		return std::nullopt;
+	return w.size();
+}
+
+void exporter::serve_until(std::chrono::steady_clock::time_point deadline) {
+	for (auto now = std::chrono::steady_clock::now(); now < deadline; now = std::chrono::steady_clock::now()) {
+		pollfd fds[max_clients + 1];
+		size_t count = 0;
+
+		// a full house leaves new connections in the backlog
+		const bool room = std::any_of(std::begin(clients), std::end(clients), [](const auto& c) { return c.fh < 0; });
+		fds[count++] = {.fd = fh, .events = static_cast<short>(room ? POLLIN : 0), .revents = 0};
+
+		auto wake = deadline;
+		for (auto& c : clients) {
+			if (c.fh < 0)
+				continue;
+			if (now >= c.deadline) {
+				drop(c);
+				continue;
+			}
+			wake = std::min(wake, c.deadline);
+			fds[count++] = {.fd = c.fh, .events = static_cast<short>(c.length ? POLLOUT : POLLIN), .revents = 0};
+		}
+
+		const auto timeout = std::chrono::ceil<std::chrono::milliseconds>(wake - now).count();
+		if (const int ready = poll(fds, count, static_cast<int>(timeout)); ready < 0 && errno == EINTR)
+			return;
+		else if (ready <= 0)
+			continue;
+
+		for (size_t i = 1; i < count; ++i) {
+			if (!fds[i].revents)
+				continue;
+
+			auto& c = *std::find_if(std::begin(clients), std::end(clients), [fd = fds[i].fd](const auto& cl) { return cl.fh == fd; });
+			if (c.length)
+				respond(c);
+			else
+				receive(c);
+		}
+
+		if (fds[0].revents & POLLIN)
+			accept_clients();
+	}
+}
+
+void exporter::accept_clients() {
+	for (auto& c : clients) {
+		if (c.fh >= 0)
+			continue;
+
+		if (c.fh = accept4(fh, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC); c.fh < 0)
+			return;
+
+		c.received = c.sent = c.length = 0;
+		c.deadline = std::chrono::steady_clock::now() + client_timeout;
+	}
+}
+
+void exporter::receive(client& c) {
+	const long len = read(c.fh, c.request + c.received, sizeof(c.request) - c.received);
+	if (len <= 0) {
+		if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+		return drop(c);
+	}
+	c.received += len;
+
+	const std::string_view request{c.request, c.received};
+	if (request.find("\r\n\r\n") == std::string_view::npos && c.received < sizeof(c.request))
+		return;
+
+	if (request.substr(0, 13) == "GET /metrics " || request.substr(0, 14) == "GET /metrics?") {
+		if (const auto length = render()) {
+			writer w{c.response, sizeof(c.response)};
+			w("HTTP/1.1 200 OK\r\n"
+			  "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+			  "Connection: close\r\n"
+			  "Content-Length: {}\r\n\r\n",
+			  *length);
+			w("{}", std::string_view{body, *length});
+			c.length = w.size();
+		} else {
+			// a cut body would still look valid to the scraper, minus whatever came last
+			logger::print(logger::error, "Metrics do not fit into {} bytes", sizeof(body));
+			c.length = too_large.size();
+			memcpy(c.response, too_large.data(), too_large.size());
+		}
+	} else {
+		c.length = not_found.size();
+		memcpy(c.response, not_found.data(), not_found.size());
+	}
+
+	respond(c);
+}
+
+void exporter::respond(client& c) {
+	const long len = send(c.fh, c.response + c.sent, c.length - c.sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+	if (len < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return;
+		return drop(c);
+	}
+
+	if (c.sent += len; c.sent == c.length)
+		drop(c);
+}
+
+void exporter::drop(client& c) {
+	if (c.fh >= 0) {
+		close(c.fh);
+		c.fh = -1;
+	}
+}
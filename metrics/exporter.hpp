@@ -0,0 +1,80 @@
+#pragma once
+
+#include "../bme280/bme280.hpp"
+#include "../bme680/bme680.hpp"
+#include "../s8/s8.hpp"
+#include "../sds011/sds011.hpp"
+#include "../sink/destination.hpp"
+#include "stats.hpp"
+
+#include <netinet/in.h>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <string_view>
+
+/*
+ * Minimal non-blocking HTTP server answering GET /metrics with the latest
+ * readings and health counters in OpenMetrics text format. It runs inside the
+ * main loop while it waits for the next probe. Responses are rendered into
+ * preallocated buffers, serving a scrape does not allocate.
+ */
+class exporter {
+ public:
+	explicit exporter(ushort port, std::string_view node, const stats&, const std::deque<destination>&);
+	explicit exporter(exporter&&) = delete;
+
+	~exporter();
+
+	void update(const s8::data&);
+
+	void update(const sds011::data&);
+
+	void update(const bme280::data&);
+
+	void update(const bme680::data&);
+
+	// serves scrapes until deadline, returns early when interrupted by a signal
+	void serve_until(std::chrono::steady_clock::time_point deadline);
+
+ private:
+	static constexpr size_t max_clients = 4;
+	static constexpr size_t buffer_size = 16384;
+	// status line and headers in front of the body
+	static constexpr size_t header_size = 256;
+
+	struct client {
+		int fh = -1;
+		size_t received = 0;
+		size_t sent = 0;
+		size_t length = 0;
+		std::chrono::steady_clock::time_point deadline;
+		char request[1024];
+		char response[header_size + buffer_size];
+	};
+
+	int fh;
+	std::string_view node;
+	const stats& health;
+	const std::deque<destination>& destinations;
+
+	std::optional<s8::data> s8_latest;
+	std::optional<sds011::data> sds011_latest;
+	std::optional<bme280::data> bme280_latest;
+	std::optional<bme680::data> bme680_latest;
+
+	client clients[max_clients];
+	char body[buffer_size];
+
+	// size of the body, nothing if it does not fit into the buffer
+	[[nodiscard]] std::optional<size_t> render();
+
+	void accept_clients();
+
+	void receive(client&);
+
+	void respond(client&);
+
+	void drop(client&);
+};
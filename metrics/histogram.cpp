@@ -0,0 +1,56 @@
+#include "histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+size_t histogram::index(uint64_t us) {
+	if (us < linear)
+		return us;
+
+	const size_t exponent = 63 - __builtin_clzll(us);
+	const size_t sub = (us >> (exponent - sub_bits)) & ((1 << sub_bits) - 1);
+	return linear + (exponent - 4) * (1 << sub_bits) + sub;
+}
+
+uint64_t histogram::upper(size_t index) {
+	if (index < linear)
+		return index;
+
+	const size_t exponent = (index - linear) / (1 << sub_bits) + 4;
+	const size_t sub = (index - linear) % (1 << sub_bits);
+	return (uint64_t{1} << exponent) + ((sub + 1) << (exponent - sub_bits)) - 1;
+}
+
+void histogram::record(std::chrono::steady_clock::duration d) {
+	const auto us = static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(d).count()));
+
+	++counts[index(us)];
+	++total;
+	sum += us;
+	max = std::max(max, us);
+}
+
+uint64_t histogram::count() const {
+	return total;
+}
+
+uint64_t histogram::max_us() const {
+	return max;
+}
+
+uint64_t histogram::mean_us() const {
+	return total ? sum / total : 0;
+}
+
+uint64_t histogram::quantile_us(double q) const {
+	if (!total)
+		return 0;
+
+	const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * total)));
+	uint64_t seen = 0;
+	for (size_t i = 0; i < buckets; ++i)
+		if (seen += counts[i]; seen >= rank)
+			return std::min(upper(i), max);
+
+	return max;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Log-linear latency histogram in the spirit of HdrHistogram: exact below 16us,
+ * then 8 buckets per power of two, i.e. within 12.5%. Fixed size, recording is
+ * a couple of shifts and an increment.
+ */
+class histogram {
+ public:
+	void record(std::chrono::steady_clock::duration);
+
+	[[nodiscard]] uint64_t count() const;
+
+	[[nodiscard]] uint64_t max_us() const;
+
+	[[nodiscard]] uint64_t mean_us() const;
+
+	// upper bound of the bucket holding that quantile, 0 if empty
+	[[nodiscard]] uint64_t quantile_us(double) const;
+
+ private:
+	static constexpr size_t linear = 16;
+	static constexpr size_t sub_bits = 3;
+	static constexpr size_t buckets = linear + (64 - 4) * (1 << sub_bits);
+
+	uint64_t counts[buckets] = {};
+	uint64_t total = 0;
+	uint64_t sum = 0;
+	uint64_t max = 0;
+
+	static size_t index(uint64_t us);
+
+	static uint64_t upper(size_t index);
+};
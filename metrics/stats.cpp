@@ -0,0 +1,39 @@
+#include "stats.hpp"
+
+#include <fmt/format.h>
+#include <iterator>
+
+namespace {
+void dump_latency(const histogram& h, std::string& out) {
+	fmt::format_to(
+	    std::back_inserter(out), "\"latency_us\":{{\"count\":{},\"mean\":{},\"p50\":{},\"p90\":{},\"p99\":{},\"max\":{}}}", h.count(), h.mean_us(),
+	    h.quantile_us(0.5), h.quantile_us(0.9), h.quantile_us(0.99), h.max_us());
+}
+
+void dump_sensor(const sensor_stats& s, std::string& out) {
+	fmt::format_to(
+	    std::back_inserter(out), "\"{}\":{{\"init_failures\":{},\"reads\":{},\"read_failures\":{},\"crc_failures\":{},\"short_reads\":{},", s.name,
+	    s.init_failures, s.reads, s.read_failures, s.crc_failures, s.short_reads);
+	dump_latency(s.latency, out);
+	out += '}';
+}
+};  // namespace
+
+void dump_json(const stats& st, std::string& out) {
+	fmt::format_to(std::back_inserter(out), "\"cycles\":{},\"sensors\":{{", st.cycles);
+	dump_sensor(st.s8, out);
+	out += ',';
+	dump_sensor(st.sds011, out);
+	out += ',';
+	dump_sensor(st.bme280, out);
+	out += ',';
+	dump_sensor(st.bme680, out);
+	out += '}';
+}
+
+void dump_json(const sink_stats& s, std::string& out) {
+	fmt::format_to(std::back_inserter(out), "\"{}\":{{\"sent\":{},\"send_failures\":{},\"dropped\":{},\"connects\":{},", s.name, s.sent, s.send_failures,
+	               s.dropped, s.connects);
+	dump_latency(s.latency, out);
+	out += '}';
+}
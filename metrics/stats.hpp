@@ -0,0 +1,59 @@
+#pragma once
+
+#include "histogram.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// health counters of a sensor, always on
+struct sensor_stats {
+	explicit sensor_stats(std::string_view n) : name{n} {}
+
+	std::string_view name;
+	uint64_t init_failures = 0;
+	uint64_t reads = 0;
+	uint64_t read_failures = 0;
+	uint64_t crc_failures = 0;
+	uint64_t short_reads = 0;
+	histogram latency;
+};
+
+// health counters of a destination, always on
+struct sink_stats {
+	std::string name;
+	uint64_t sent = 0;
+	uint64_t send_failures = 0;
+	// records given up on, e.g. too large to send
+	uint64_t dropped = 0;
+	uint64_t connects = 0;
+	histogram latency;
+};
+
+struct stats {
+	uint64_t cycles = 0;
+
+	sensor_stats s8{"s8"};
+	sensor_stats sds011{"sds011"};
+	sensor_stats bme280{"bme280"};
+	sensor_stats bme680{"bme680"};
+};
+
+// append json object members, without the braces
+void dump_json(const stats&, std::string& out);
+
+void dump_json(const sink_stats&, std::string& out);
+
+// appends {"cycles":..,"sensors":{..},"sinks":{..}} to out, sinks are anything with statistics()
+template <typename Sinks>
+void dump_json(const stats& st, const Sinks& sinks, std::string& out) {
+	out += '{';
+	dump_json(st, out);
+	out += ",\"sinks\":{";
+	for (const auto& s : sinks) {
+		if (out.back() != '{')
+			out += ',';
+		dump_json(s.statistics(), out);
+	}
+	out += "}}";
+}
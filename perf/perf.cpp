@@ -0,0 +1,124 @@
+#include "perf.hpp"
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+
+namespace perf {
+
+namespace {
+constexpr const char* stage_names[] = {"encode", "parse", "compensation", "send"};
+constexpr const char* event_names[] = {"cycles", "instructions", "cache_misses", "context_switches"};
+
+// joins the group of leader, or leads a new one without it
+int open_event(uint32_t type, uint64_t config, bool user_only, int leader) {
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	// user space only works with perf_event_paranoid 2 and keeps syscalls of the reads themselves out
+	attr.exclude_kernel = user_only;
+	attr.exclude_hv = 1;
+	// one read gives every counter of the group
+	attr.read_format = PERF_FORMAT_GROUP;
+
+	return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, PERF_FLAG_FD_CLOEXEC));
+}
+};  // namespace
+
+counters* counters::active = nullptr;
+
+counters::counters() {
+	static_assert(std::extent_v<decltype(stage_names)> == static_cast<size_t>(stage::count));
+	static_assert(std::extent_v<decltype(event_names)> == events);
+
+	if (active)
+		throw std::runtime_error("Counters are already active");
+
+	const struct {
+		uint32_t type;
+		uint64_t config;
+		bool user_only;
+	} kinds[events] = {
+	    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, true},
+	    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, true},
+	    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, true},
+	    // switches happen in the kernel, excluding it would always count zero
+	    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, false},
+	};
+
+	// the first counter available leads the group, the others come in the order they joined
+	size_t members = 0;
+	for (size_t i = 0; i < events; ++i) {
+		fds[i] = open_event(kinds[i].type, kinds[i].config, kinds[i].user_only, leader);
+		if (fds[i] < 0)
+			continue;
+		if (leader < 0)
+			leader = fds[i];
+		slots[i] = members++;
+	}
+
+	if (leader < 0)
+		throw std::runtime_error(fmt::format("Failed to open any perf counter: {}", strerror(errno)));
+
+	active = this;
+}
+
+counters::~counters() {
+	active = nullptr;
+
+	for (int fd : fds)
+		if (fd >= 0)
+			close(fd);
+}
+
+void counters::read_all(uint64_t (&values)[events]) const {
+	// the number of counters, then their values
+	uint64_t group[1 + events];
+	if (read(leader, group, sizeof(group)) < static_cast<long>(sizeof(group[0])))
+		group[0] = 0;
+
+	for (size_t i = 0; i < events; ++i)
+		values[i] = fds[i] >= 0 && slots[i] < group[0] ? group[1 + slots[i]] : 0;
+}
+
+void counters::dump_json(std::string& out) const {
+	auto it = std::back_inserter(out);
+
+	out += '{';
+	for (size_t s = 0; s < static_cast<size_t>(stage::count); ++s) {
+		fmt::format_to(it, "{}\"{}\":{{\"calls\":{}", s ? "," : "", stage_names[s], calls[s]);
+		for (size_t e = 0; e < events; ++e)
+			if (fds[e] >= 0)
+				fmt::format_to(it, ",\"{}\":{}", event_names[e], totals[s][e]);
+		out += '}';
+	}
+	out += '}';
+}
+
+region::region(stage s) : where{s}, counting{counters::active != nullptr} {
+	if (counting)
+		counters::active->read_all(start);
+}
+
+region::~region() {
+	if (auto* c = counters::active; c && counting) {
+		uint64_t end[counters::events];
+		c->read_all(end);
+
+		const auto idx = static_cast<size_t>(where);
+		++c->calls[idx];
+		for (size_t i = 0; i < counters::events; ++i)
+			c->totals[idx][i] += end[i] - start[i];
+	}
+}
+
+};  // namespace perf
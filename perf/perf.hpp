@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * Hardware counters per hot stage of a probe, read with perf_event_open(2) as
+ * one group, so a region boundary costs a single read. Counters the CPU or
+ * kernel does not provide stay unavailable and are left out of the report.
+ * Regions cost one pointer check while no counters are active, so they can
+ * stay in the drivers.
+ */
+namespace perf {
+
+enum class stage { encode, parse, compensation, send, count };
+
+class counters {
+ public:
+	explicit counters();
+	explicit counters(counters&&) = delete;
+
+	~counters();
+
+	// appends {"encode":{"calls":..,"cycles":..,..},..} to out
+	void dump_json(std::string& out) const;
+
+	static counters* active;
+
+ private:
+	friend class region;
+
+	enum event { cycles, instructions, cache_misses, context_switches, events };
+
+	int fds[events];
+	int leader = -1;
+	// position of every counter in a read of the group
+	size_t slots[events] = {};
+	uint64_t totals[static_cast<size_t>(stage::count)][events] = {};
+	uint64_t calls[static_cast<size_t>(stage::count)] = {};
+
+	void read_all(uint64_t (&values)[events]) const;
+};
+
+// counts everything between construction and destruction into the stage
+class region {
+ public:
+	explicit region(stage);
+
+	region(const region&) = delete;
+
+	~region();
+
+ private:
+	stage where;
+	bool counting;
+	uint64_t start[counters::events];
+};
+
+};  // namespace perf
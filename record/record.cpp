@@ -0,0 +1,97 @@
+#include "record.hpp"
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+void encode_json(const record& r, std::string& out) {
+	auto it = std::back_inserter(out);
+
+	fmt::format_to(it, "{{\"name\":\"{}\"", r.name);
+	if (r.run)
+		fmt::format_to(it, ",\"run\":{}", *r.run);
+	if (r.seq)
+		fmt::format_to(it, ",\"seq\":{}", *r.seq);
+	for (const auto& f : r.fields)
+		std::visit([&](auto v) { fmt::format_to(it, ",\"{}\":{}", f.key, v); }, f.val);
+	if (!r.json_extra.empty()) {
+		out += ',';
+		out += r.json_extra;
+	}
+	out += '}';
+}
+
+// https://docs.influxdata.com/influxdb/v1/write_protocols/line_protocol_reference/
+void encode_influx(const record& r, std::string& out) {
+	auto it = std::back_inserter(out);
+	char separator = ' ';
+
+	fmt::format_to(it, "air,name={}", r.name);
+	if (r.run) {
+		fmt::format_to(it, "{}run={}i", separator, *r.run);
+		separator = ',';
+	}
+	if (r.seq) {
+		fmt::format_to(it, "{}seq={}i", separator, *r.seq);
+		separator = ',';
+	}
+	for (const auto& f : r.fields) {
+		if (const auto* i = std::get_if<int64_t>(&f.val))
+			fmt::format_to(it, "{}{}={}i", separator, f.key, *i);
+		else
+			fmt::format_to(it, "{}{}={}", separator, f.key, std::get<double>(f.val));
+		separator = ',';
+	}
+	// line protocol does not allow a point without fields
+	if (separator == ' ')
+		out += " empty=true";
+}
+};  // namespace
+
+void record::add(std::string_view key, value val) {
+	fields.push_back({key, val});
+}
+
+const record::field* record::find(std::string_view key) const {
+	auto it = std::find_if(fields.begin(), fields.end(), [key](const auto& f) { return f.key == key; });
+	return it == fields.end() ? nullptr : &*it;
+}
+
+void record::clear() {
+	run.reset();
+	seq.reset();
+	fields.clear();
+	json_extra.clear();
+}
+
+format parse_format(std::string_view str) {
+	if (str == "json")
+		return format::json;
+	if (str == "influx")
+		return format::influx;
+	throw std::runtime_error(fmt::format("Unknown format '{}'", str));
+}
+
+void encode(const record& r, format f, std::string& out) {
+	switch (f) {
+		case format::json:
+			return encode_json(r, out);
+		case format::influx:
+			return encode_influx(r, out);
+	}
+}
+
+void escape_json(std::string_view text, std::string& out) {
+	for (const char c : text) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			fmt::format_to(std::back_inserter(out), "\\u{:04x}", static_cast<int>(c));
+		} else {
+			out += c;
+		}
+	}
+}
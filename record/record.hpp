@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+/*
+ * One probe of all sensors, kept typed until it is encoded for a receiver.
+ * Keys have to outlive the record, in practice they are string literals.
+ */
+struct record {
+	using value = std::variant<int64_t, double>;
+
+	struct field {
+		std::string_view key;
+		value val;
+	};
+
+	std::string_view name;
+	std::optional<int64_t> run;
+	std::optional<uint64_t> seq;
+	std::vector<field> fields;
+	// already encoded json members, e.g. "stats":{..}; only the json format carries them
+	std::string json_extra;
+
+	void add(std::string_view key, value val);
+
+	[[nodiscard]] const field* find(std::string_view key) const;
+
+	// keeps capacity, so a record reused between probes does not allocate
+	void clear();
+};
+
+enum class format { json, influx };
+
+[[nodiscard]] format parse_format(std::string_view);
+
+// appends encoded record to out
+void encode(const record&, format, std::string& out);
+
+// appends text escaped to go between the quotes of a json string
+void escape_json(std::string_view text, std::string& out);
@@ -1,7 +1,6 @@
 #include "s8.hpp"
-
-#include <fcntl.h>
-#include <unistd.h>
+#include "../errors/errors.hpp"
+#include "../perf/perf.hpp"
 
 #include <fmt/core.h>
 #include <exception>
@@ -9,77 +8,12 @@
 #include <string_view>
 
 namespace {
-constexpr std::string_view path = "/dev/serial/by-id/usb-Silicon_Labs_CP2102_USB_to_UART_Bridge_Controller_0001-if00-port0";
-
 constexpr uint8_t request[7] = {0xFE, 0x44, 0x00, 0x08, 0x02, 0x9F, 0x25};
-
-void configure_interface(int fh, int speed) {
-	termios tty;
-
-	if (tcgetattr(fh, &tty) < 0)
-		throw std::runtime_error(fmt::format("Failed to tcgetattr: {}", strerror(errno)));
-
-	cfsetospeed(&tty, (speed_t)speed);
-	cfsetispeed(&tty, (speed_t)speed);
-
-	tty.c_cflag |= (CLOCAL | CREAD); /* ignore modem controls */
-	tty.c_cflag &= ~CSIZE;
-	tty.c_cflag |= CS8;      /* 8-bit characters */
-	tty.c_cflag &= ~PARENB;  /* no parity bit */
-	tty.c_cflag &= ~CSTOPB;  /* only need 1 stop bit */
-	tty.c_cflag &= ~CRTSCTS; /* no hardware flowcontrol */
-
-	/* setup for non-canonical mode */
-	tty.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
-	tty.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
-	tty.c_oflag &= ~OPOST;
-
-	/* fetch bytes as they become available */
-	tty.c_cc[VMIN] = 7;
-	tty.c_cc[VTIME] = 5;
-
-	if (tcsetattr(fh, TCSANOW, &tty) != 0)
-		throw std::runtime_error(fmt::format("Failed to tcsetattr: {}", strerror(errno)));
-}
 };  // namespace
 
-s8::s8() : fh{open(path.data(), O_RDWR | O_NOCTTY | O_SYNC)} {
-	if (fh < 0)
-		throw std::runtime_error(fmt::format("Failed to open '{}': {}", path, strerror(errno)));
-
-	try {
-		if (tcgetattr(fh, &tty_back) < 0)
-			throw std::runtime_error(fmt::format("Failed to tcgetattr: {}", strerror(errno)));
+s8::s8(const std::string& path) : s8{tty::open(path, {.speed = B9600, .min = 7, .time = 5})} {}
 
-		configure_interface(fh, B9600);
-
-		/* There is a problem with flushing buffers on a serial USB that can
-		 * not be solved. The only thing one can try is to flush any buffers
-		 * after some delay:
-		 *
-		 * https://bugzilla.kernel.org/show_bug.cgi?id=5730
-		 * https://stackoverflow.com/questions/13013387/clearing-the-serial-ports-buffer
-		 */
-		usleep(10000);
-		tcflush(fh, TCIOFLUSH);
-	} catch (...) {
-		close(fh);
-		throw;
-	}
-}
-
-s8::s8(s8&& o) : fh{o.fh}, tty_back{o.tty_back} {
-	o.fh = 0;
-}
-
-s8::~s8() {
-	if (fh) {
-		if (tcsetattr(fh, TCSANOW, &tty_back) < 0)
-			fmt::print(stderr, "Failed to reset tcsetattr: {}", strerror(errno));
-
-		close(fh);
-	}
-}
+s8::s8(std::unique_ptr<tty::port> p) : port{std::move(p)} {}
 
 void s8::send_command() {
 #ifndef NDEBUG
@@ -89,11 +23,11 @@ void s8::send_command() {
 	fmt::print("\n");
 #endif
 
-	if (write(fh, request, std::extent_v<decltype(request)>) != std::extent_v<decltype(request)>)
+	if (port->write(request, std::extent_v<decltype(request)>) != std::extent_v<decltype(request)>)
 		throw std::runtime_error(fmt::format("USB control write failed: {}", +strerror(errno)));
 
-	if (auto bytes = read(fh, response, std::extent_v<decltype(response)>); bytes != std::extent_v<decltype(response)>)
-		throw std::runtime_error(fmt::format("USB read failed, read only {}: {}", bytes, strerror(errno)));
+	if (auto bytes = port->read(response, std::extent_v<decltype(response)>); bytes != std::extent_v<decltype(response)>)
+		throw short_read_error(fmt::format("USB read failed, read only {}: {}", bytes, strerror(errno)));
 
 #ifndef NDEBUG
 	fmt::print("> ");
@@ -110,5 +44,15 @@ void s8::print_data() {
 
 s8::data s8::get_data() {
 	send_command();
-	return {.co2 = uint64_t(response[3] << 8) + response[4]};
+	return decode(response);
+}
+
+s8::data s8::decode(const uint8_t (&frame)[7]) {
+	perf::region region{perf::stage::parse};
+
+	constexpr uint8_t crc_idx = 5;
+	if (crc16(frame, crc_idx) != frame[crc_idx] + (frame[crc_idx + 1] << 8))
+		throw crc_error("CRC check failed");
+
+	return {.co2 = uint64_t(frame[3] << 8) + frame[4]};
 }
\ No newline at end of file
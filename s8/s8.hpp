@@ -1,15 +1,19 @@
 #pragma once
 
-#include <termios.h>
+#include "../tty/tty.hpp"
+
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string>
 
 class s8 {
  public:
-	explicit s8();
-	explicit s8(s8&&);
+	static constexpr const char* default_path = "/dev/serial/by-id/usb-Silicon_Labs_CP2102_USB_to_UART_Bridge_Controller_0001-if00-port0";
 
-	~s8();
+	explicit s8(const std::string& path = default_path);
+	// e.g. a replayed capture
+	explicit s8(std::unique_ptr<tty::port>);
 
 	void print_data();
 
@@ -19,10 +23,22 @@ class s8 {
 
 	[[nodiscard]] data get_data();
 
- private:
-	int fh;
+	// reading from a reply frame, throws on CRC mismatch
+	[[nodiscard]] static data decode(const uint8_t (&frame)[7]);
 
-	termios tty_back;
+	// modbus CRC-16, transmitted low byte first; inline, so that the emulator needs no driver
+	[[nodiscard]] static constexpr uint16_t crc16(const uint8_t* data, size_t size) {
+		uint16_t crc = 0xffff;
+		for (size_t i = 0; i < size; ++i) {
+			crc ^= data[i];
+			for (int bit = 0; bit < 8; ++bit)
+				crc = (crc & 1) ? (crc >> 1) ^ 0xa001 : crc >> 1;
+		}
+		return crc;
+	}
+
+ private:
+	std::unique_ptr<tty::port> port;
 
 	uint8_t response[7];
 
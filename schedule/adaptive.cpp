@@ -0,0 +1,56 @@
+#include "adaptive.hpp"
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+adaptive_interval::adaptive_interval(clock::duration mn, clock::duration mx, double t) : min{mn}, max{mx}, threshold{t}, current{mx} {
+	if (min <= clock::duration::zero() || min > max)
+		throw std::runtime_error("Adaptive interval should be positive and below the interval");
+	if (threshold <= 0)
+		throw std::runtime_error(fmt::format("Adaptive threshold {} should be positive", threshold));
+}
+
+bool adaptive_interval::due(clock::time_point now) const {
+	return now >= next_probe;
+}
+
+adaptive_interval::clock::time_point adaptive_interval::next() const {
+	return next_probe;
+}
+
+adaptive_interval::clock::duration adaptive_interval::interval() const {
+	return current;
+}
+
+void adaptive_interval::probed(clock::time_point now) {
+	probed_at = now;
+	next_probe = now + current;
+}
+
+void adaptive_interval::update(std::initializer_list<double> values, clock::time_point now) {
+	// weighted by time, so that faster sampling does not shorten the memory
+	const double alpha = known ? 1 - std::exp(-std::chrono::duration<double>(now - last_at) / std::chrono::duration<double>(max)) : 1;
+
+	bool volatile_values = false;
+	size_t i = 0;
+	for (double v : values) {
+		const double diff = v - mean[i];
+		const double increment = alpha * diff;
+		mean[i] += increment;
+		variance[i] = (1 - alpha) * (variance[i] + diff * increment);
+		// absolute spread while values are tiny, e.g. clean air
+		volatile_values |= std::sqrt(variance[i]) > threshold * std::max(std::abs(mean[i]), 1.0);
+		if (++i == max_fields)
+			break;
+	}
+
+	if (known)
+		current = volatile_values ? std::max(min, current / 2) : std::min(max, current + current / 4);
+
+	last_at = now;
+	known = true;
+	// from the probe, a reading may be older, e.g. a file written a while ago
+	next_probe = probed_at + current;
+}
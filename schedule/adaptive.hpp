@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <initializer_list>
+
+/*
+ * Sampling interval of one sensor, driven by how much its readings move: an
+ * exponentially weighted mean and variance over about max. While the
+ * standard deviation is above threshold times the mean, every reading halves
+ * the interval down to min, otherwise it is stretched by a quarter up to max.
+ * Fast to react to an event, slow to give up on it.
+ */
+class adaptive_interval {
+ public:
+	using clock = std::chrono::steady_clock;
+
+	adaptive_interval(clock::duration min, clock::duration max, double threshold);
+
+	[[nodiscard]] bool due(clock::time_point now) const;
+
+	[[nodiscard]] clock::time_point next() const;
+
+	// called for every attempt, a failed read waits for the next turn too
+	void probed(clock::time_point now);
+
+	// up to max_fields values of a reading taken at now, after probed
+	void update(std::initializer_list<double> values, clock::time_point now);
+
+	[[nodiscard]] clock::duration interval() const;
+
+	static constexpr size_t max_fields = 2;
+
+ private:
+	clock::duration min;
+	clock::duration max;
+	double threshold;
+
+	clock::duration current;
+	clock::time_point probed_at{};
+	clock::time_point next_probe{};
+
+	std::array<double, max_fields> mean{};
+	std::array<double, max_fields> variance{};
+	clock::time_point last_at{};
+	bool known = false;
+};
@@ -1,15 +1,18 @@
 #pragma once
 
-#include <termios.h>
+#include "../tty/tty.hpp"
+
 #include <cstdint>
+#include <memory>
 #include <string>
 
 class sds011 {
  public:
-	explicit sds011();
-	explicit sds011(sds011&&);
+	static constexpr const char* default_path = "/dev/serial/by-id/usb-1a86_USB_Serial-if00-port0";
 
-	~sds011();
+	explicit sds011(const std::string& path = default_path);
+	// e.g. a replayed capture
+	explicit sds011(std::unique_ptr<tty::port>);
 
 	void firmware_ver();
 
@@ -28,10 +31,14 @@ class sds011 {
 
 	[[nodiscard]] data get_data();
 
- private:
-	int fh;
+	// throws if checksum or tail of a reply frame is wrong
+	static void verify(const uint8_t (&frame)[10]);
 
-	termios tty_back;
+	// reading from a verified query reply frame
+	[[nodiscard]] static data decode(const uint8_t (&frame)[10]);
+
+ private:
+	std::unique_ptr<tty::port> port;
 
 	uint8_t response[10];
 	uint8_t request[19] = {0xaa, 0xb4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff, 0, 0xab};
@@ -0,0 +1,164 @@
+#pragma once
+
+/*
+ * Latest reading of every sensor, published by air in shared memory.
+ *
+ * Every slot is a seqlock: the writer makes seq odd, updates the values and
+ * makes it even again. Readers copy the values and retry if seq changed in
+ * between, so they never see a torn reading and never make a syscall after
+ * the region is mapped.
+ *
+ *   airshm::reader shm;
+ *   airshm::s8_values co2;
+ *   int64_t when;
+ *   if (shm->s8.load(co2, when))
+ *     ...
+ *
+ * Header only, consumers need nothing else from air.
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace airshm {
+
+constexpr const char* default_name = "/air";
+constexpr uint64_t magic = 0x314d485352494141;  // "AAIRSHM1"
+constexpr uint32_t version = 1;
+
+struct s8_values {
+	int64_t co2;
+};
+
+struct sds011_values {
+	int64_t deca_pm25;
+	int64_t deca_pm10;
+};
+
+struct climate_values {
+	int64_t deca_humidity;
+	int64_t deca_kelvin;
+	double gas;  // NaN until heater is stable, always NaN for bme280
+};
+
+template <typename T>
+struct alignas(64) slot {
+	static_assert(sizeof(T) % sizeof(uint64_t) == 0, "values should be whole words");
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared atomics should be lock free");
+
+	// even when stable, zero when never written
+	std::atomic<uint64_t> seq;
+	// CLOCK_REALTIME of the reading
+	std::atomic<int64_t> realtime_ns;
+	std::atomic<uint64_t> words[sizeof(T) / sizeof(uint64_t)];
+
+	// single writer only
+	void store(const T& value, int64_t when) {
+		uint64_t raw[std::extent_v<decltype(words)>];
+		memcpy(raw, &value, sizeof(value));
+
+		const auto s = seq.load(std::memory_order_relaxed);
+		seq.store(s + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		realtime_ns.store(when, std::memory_order_relaxed);
+		for (size_t i = 0; i < std::extent_v<decltype(words)>; ++i)
+			words[i].store(raw[i], std::memory_order_relaxed);
+
+		seq.store(s + 2, std::memory_order_release);
+	}
+
+	// false if never written or the writer died in the middle of an update
+	[[nodiscard]] bool load(T& value, int64_t& when, unsigned retries = 1000) const {
+		uint64_t raw[std::extent_v<decltype(words)>];
+
+		do {
+			const auto before = seq.load(std::memory_order_acquire);
+			if (!before)
+				return false;
+			if (before & 1)
+				continue;
+
+			when = realtime_ns.load(std::memory_order_relaxed);
+			for (size_t i = 0; i < std::extent_v<decltype(words)>; ++i)
+				raw[i] = words[i].load(std::memory_order_relaxed);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (seq.load(std::memory_order_relaxed) == before) {
+				memcpy(&value, raw, sizeof(value));
+				return true;
+			}
+		} while (retries--);
+
+		return false;
+	}
+};
+
+struct region {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t size;
+
+	slot<s8_values> s8;
+	slot<sds011_values> sds011;
+	slot<climate_values> bme280;
+	slot<climate_values> bme680;
+};
+
+// read only mapping of the region
+class reader {
+ public:
+	explicit reader(const std::string& name = default_name) {
+		const int fh = shm_open(name.c_str(), O_RDONLY, 0);
+		if (fh < 0)
+			throw std::runtime_error("Failed to open '" + name + "': " + strerror(errno));
+
+		struct stat st;
+		if (fstat(fh, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(region)) {
+			close(fh);
+			throw std::runtime_error("Shared memory '" + name + "' is too small");
+		}
+
+		void* addr = mmap(nullptr, sizeof(region), PROT_READ, MAP_SHARED, fh, 0);
+		close(fh);
+		if (addr == MAP_FAILED)
+			throw std::runtime_error("Failed to mmap '" + name + "': " + strerror(errno));
+
+		shared = static_cast<const region*>(addr);
+		if (shared->magic != magic || shared->version != version || shared->size != sizeof(region)) {
+			munmap(const_cast<region*>(shared), sizeof(region));
+			throw std::runtime_error("Shared memory '" + name + "' has unknown layout");
+		}
+	}
+
+	reader(const reader&) = delete;
+	reader& operator=(const reader&) = delete;
+
+	~reader() {
+		munmap(const_cast<region*>(shared), sizeof(region));
+	}
+
+	const region& operator*() const {
+		return *shared;
+	}
+
+	const region* operator->() const {
+		return shared;
+	}
+
+ private:
+	const region* shared;
+};
+
+};  // namespace airshm
@@ -0,0 +1,79 @@
+#include "publisher.hpp"
+
+#include <fmt/core.h>
+#include <cmath>
+#include <ctime>
+#include <stdexcept>
+
+namespace {
+int64_t now() {
+	timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * int64_t{1000000000} + ts.tv_nsec;
+}
+
+template <typename T>
+void recover(airshm::slot<T>& slot) {
+	// previous writer died in the middle of an update
+	if (const auto seq = slot.seq.load(std::memory_order_relaxed); seq & 1)
+		slot.seq.store(seq + 1, std::memory_order_release);
+}
+};  // namespace
+
+publisher::publisher(const std::string& name) : shared{nullptr} {
+	const int fh = shm_open(name.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fh < 0)
+		throw std::runtime_error(fmt::format("Failed to open '{}': {}", name, strerror(errno)));
+
+	if (ftruncate(fh, sizeof(airshm::region)) < 0) {
+		close(fh);
+		throw std::runtime_error(fmt::format("Failed to resize '{}': {}", name, strerror(errno)));
+	}
+
+	void* addr = mmap(nullptr, sizeof(airshm::region), PROT_READ | PROT_WRITE, MAP_SHARED, fh, 0);
+	close(fh);
+	if (addr == MAP_FAILED)
+		throw std::runtime_error(fmt::format("Failed to mmap '{}': {}", name, strerror(errno)));
+
+	shared = static_cast<airshm::region*>(addr);
+	if (shared->magic != airshm::magic || shared->version != airshm::version || shared->size != sizeof(airshm::region)) {
+		memset(static_cast<void*>(shared), 0, sizeof(airshm::region));
+		shared->version = airshm::version;
+		shared->size = sizeof(airshm::region);
+		std::atomic_thread_fence(std::memory_order_release);
+		shared->magic = airshm::magic;
+	}
+
+	recover(shared->s8);
+	recover(shared->sds011);
+	recover(shared->bme280);
+	recover(shared->bme680);
+}
+
+publisher::publisher(publisher&& o) : shared{o.shared} {
+	o.shared = nullptr;
+}
+
+publisher::~publisher() {
+	if (shared)
+		munmap(shared, sizeof(airshm::region));
+}
+
+void publisher::publish(const s8::data& data) {
+	shared->s8.store({.co2 = static_cast<int64_t>(data.co2)}, now());
+}
+
+void publisher::publish(const sds011::data& data) {
+	shared->sds011.store({.deca_pm25 = static_cast<int64_t>(data.deca_pm25), .deca_pm10 = static_cast<int64_t>(data.deca_pm10)}, now());
+}
+
+void publisher::publish(const bme280::data& data) {
+	shared->bme280.store(
+	    {.deca_humidity = static_cast<int64_t>(data.deca_humidity), .deca_kelvin = static_cast<int64_t>(data.deca_kelvin), .gas = NAN}, now());
+}
+
+void publisher::publish(const bme680::data& data) {
+	shared->bme680.store(
+	    {.deca_humidity = static_cast<int64_t>(data.deca_humidity), .deca_kelvin = static_cast<int64_t>(data.deca_kelvin), .gas = data.gas.value_or(NAN)},
+	    now());
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "../bme280/bme280.hpp"
+#include "../bme680/bme680.hpp"
+#include "../s8/s8.hpp"
+#include "../sds011/sds011.hpp"
+#include "airshm.hpp"
+
+#include <string>
+
+// writer side of airshm.hpp
+class publisher {
+ public:
+	explicit publisher(const std::string& name);
+	explicit publisher(publisher&&);
+
+	~publisher();
+
+	void publish(const s8::data&);
+
+	void publish(const sds011::data&);
+
+	void publish(const bme280::data&);
+
+	void publish(const bme680::data&);
+
+ private:
+	airshm::region* shared;
+};
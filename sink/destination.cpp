@@ -0,0 +1,322 @@
+#include "destination.hpp"
+#include "../errors/errors.hpp"
+#include "../logger/logger.hpp"
+#include "../perf/perf.hpp"
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <charconv>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+constexpr auto max_backoff = std::chrono::seconds(300);
+
+constexpr std::string_view udp_scheme = "udp://";
+constexpr std::string_view tcp_scheme = "tcp://";
+constexpr std::string_view unix_scheme = "unix://";
+
+template <typename T>
+T parse_number(std::string_view str, std::string_view what) {
+	T result{};
+	if (auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), result); ec != std::errc{} || end != str.data() + str.size())
+		throw std::runtime_error(fmt::format("Failed to parse {} '{}'", what, str));
+	return result;
+}
+};  // namespace
+
+destination::config destination::config::parse(std::string_view spec, const config& defaults) {
+	config result = defaults;
+
+	auto address = spec.substr(0, spec.find('?'));
+	spec.remove_prefix(std::min(spec.size(), address.size() + 1));
+
+	result.kind = transport::udp;
+	for (auto [scheme, kind] : {std::pair{udp_scheme, transport::udp}, {tcp_scheme, transport::tcp}, {unix_scheme, transport::local}}) {
+		if (address.substr(0, scheme.size()) == scheme) {
+			address.remove_prefix(scheme.size());
+			result.kind = kind;
+		}
+	}
+
+	if (result.kind == transport::local) {
+		if (address.empty())
+			throw std::runtime_error("Unix destination should have a path");
+		result.host = address;
+		result.port = 0;
+	} else {
+		// last colon, so that bare IPv6 addresses work
+		const auto colon = address.rfind(':');
+		if (colon == std::string_view::npos || !colon)
+			throw std::runtime_error(fmt::format("Destination '{}' should be host:port", address));
+		result.host = address.substr(0, colon);
+		result.port = parse_number<ushort>(address.substr(colon + 1), "port");
+	}
+
+	bool nack = false;
+	while (!spec.empty()) {
+		const auto option = spec.substr(0, spec.find('&'));
+		spec.remove_prefix(std::min(spec.size(), option.size() + 1));
+
+		const auto eq = option.find('=');
+		if (eq == std::string_view::npos)
+			throw std::runtime_error(fmt::format("Destination option '{}' should be key=value", option));
+		const auto key = option.substr(0, eq);
+		const auto value = option.substr(eq + 1);
+
+		if (key == "format")
+			result.encoding = parse_format(value);
+		else if (key == "batch")
+			result.batch = std::max(1u, parse_number<uint>(value, "batch"));
+		else if (key == "spool")
+			result.spool = value;
+		else if (key == "nack") {
+			result.window = parse_number<size_t>(value, "nack window");
+			nack = true;
+		} else {
+			throw std::runtime_error(fmt::format("Unknown destination option '{}'", key));
+		}
+	}
+
+	// NACKs come back as datagrams, a stream loses nothing it has not reported already
+	if (result.kind != transport::udp) {
+		if (nack)
+			throw std::runtime_error(fmt::format("Destination '{}' is a stream, nack is only for udp", address));
+		result.window = 0;
+	}
+
+	return result;
+}
+
+destination::destination(config c) : cfg{std::move(c)}, batched{0}, failures{0} {
+	st.name = cfg.kind == transport::local ? fmt::format("unix://{}", cfg.host)
+	                                       : fmt::format("{}://{}:{}", cfg.kind == transport::tcp ? "tcp" : "udp", cfg.host, cfg.port);
+
+	if (!cfg.spool.empty())
+		backlog.emplace(cfg.spool, cfg.spool_size);
+
+	if (cfg.window)
+		window.emplace(cfg.window);
+}
+
+destination::~destination() {
+	if (batched)
+		flush();
+	// one more chance for the stream, then the rest waits in the spool for the next run
+	static_cast<void>(drain());
+	take_back();
+}
+
+format destination::encoding() const {
+	return cfg.encoding;
+}
+
+const sink_stats& destination::statistics() const {
+	return st;
+}
+
+void destination::push(uint64_t seq, std::string_view record) {
+	if (window)
+		window->add(seq, record);
+
+	// a datagram lost to fragmentation would take the whole batch with it
+	if (batched && cfg.kind == transport::udp && batch.size() + 1 + record.size() > max_datagram)
+		flush();
+
+	if (batched++)
+		batch += '\n';
+	else
+		batch_started = std::chrono::steady_clock::now();
+	batch += record;
+
+	if (batched >= cfg.batch)
+		flush();
+}
+
+void destination::tick(std::chrono::steady_clock::time_point now) {
+	if (batched && cfg.batch_age.count() && now - batch_started >= cfg.batch_age)
+		flush();
+}
+
+void destination::flush() {
+	// spooled batches and the fresh one leave in as few segments as possible
+	cork(true);
+
+	// older records go out first, the fresh batch waits in the spool while there is a backlog
+	replay_spool();
+	if (backlog && !backlog->empty())
+		keep(batch);
+	else if (!send(batch) && backlog)
+		keep(batch);
+
+	cork(false);
+
+	batch.clear();
+	batched = 0;
+}
+
+void destination::serve_nacks() {
+	if (!window || !client)
+		return;
+
+	try {
+		char buffer[1500];
+		for (auto nack = client->receive(buffer, sizeof(buffer)); !nack.empty(); nack = client->receive(buffer, sizeof(buffer)))
+			for (auto record : window->requested(nack))
+				client->send(record);
+	} catch (const std::exception& e) {
+		fail("serve nack", e);
+	}
+}
+
+bool destination::connect() {
+	if (client || stream)
+		return true;
+
+	if (std::chrono::steady_clock::now() < retry_at)
+		return false;
+
+	try {
+		switch (cfg.kind) {
+			case transport::udp:
+				client.emplace();
+				client->connect(cfg.host, cfg.port);
+				break;
+			case transport::tcp:
+				stream.emplace();
+				stream->connect(cfg.host, cfg.port);
+				break;
+			case transport::local:
+				stream.emplace();
+				stream->connect(cfg.host);
+				break;
+		}
+		++st.connects;
+		delivered = 0;
+		return true;
+	} catch (const std::exception& e) {
+		fail("connect", e);
+		return false;
+	}
+}
+
+bool destination::send(std::string_view data) {
+	if (!connect())
+		return false;
+
+	try {
+		perf::region region{perf::stage::send};
+		const auto started = std::chrono::steady_clock::now();
+		if (client) {
+			client->send(data);
+			++st.sent;
+		} else {
+			stream->send(data);
+			count_delivered();
+		}
+		st.latency.record(std::chrono::steady_clock::now() - started);
+		failures = 0;
+		return true;
+	} catch (const message_size_error& e) {
+		// neither spooled nor retried, it would hold up everything behind it
+		logger::print(logger::error, "Dropped record for {}: {}", st.name, e.what());
+		++st.dropped;
+		return true;
+	} catch (const std::exception& e) {
+		++st.send_failures;
+		fail("send data", e);
+		return false;
+	}
+}
+
+void destination::cork(bool on) {
+	if (stream) {
+		try {
+			stream->cork(on);
+		} catch (const std::exception& e) {
+			fail("cork", e);
+		}
+	}
+}
+
+void destination::keep(std::string_view data) {
+	try {
+		backlog->push(data);
+	} catch (const std::exception& e) {
+		// too large for the spool, the next record may well fit
+		logger::print(logger::error, "Dropped record for {}: {}", st.name, e.what());
+		++st.dropped;
+	}
+}
+
+void destination::replay_spool() {
+	for (auto limit = cfg.spool_rate; limit && backlog && !backlog->empty(); --limit) {
+		if (!drain() || !send(backlog->front()))
+			return;
+		// the record stays spooled until the socket took all of it
+		if (stream && stream->backed_up()) {
+			spooled_in_flight = true;
+			return;
+		}
+		backlog->pop();
+	}
+}
+
+bool destination::drain() {
+	if (!stream || !stream->backed_up())
+		return true;
+
+	try {
+		stream->flush();
+		count_delivered();
+	} catch (const std::exception& e) {
+		++st.send_failures;
+		fail("send data", e);
+		return false;
+	}
+
+	if (stream->backed_up())
+		return false;
+	if (spooled_in_flight) {
+		spooled_in_flight = false;
+		backlog->pop();
+	}
+	return true;
+}
+
+void destination::count_delivered() {
+	st.sent += stream->delivered() - delivered;
+	delivered = stream->delivered();
+}
+
+void destination::take_back() {
+	if (!stream)
+		return;
+
+	const auto unsent = stream->take_pending();
+	// a spooled record in flight is still at the front of the spool, and nothing else was sent behind it
+	if (spooled_in_flight) {
+		spooled_in_flight = false;
+		return;
+	}
+
+	for (size_t begin = 0, end; (end = unsent.find('\n', begin)) != std::string::npos; begin = end + 1) {
+		if (backlog) {
+			keep(std::string_view{unsent}.substr(begin, end - begin));
+		} else {
+			logger::print(logger::error, "Dropped record for {}: connection lost before it was sent", st.name);
+			++st.dropped;
+		}
+	}
+}
+
+void destination::fail(std::string_view what, const std::exception& e) {
+	logger::print(logger::error, "Failed to {} to {}: {}", what, st.name, e.what());
+	take_back();
+	client.reset();
+	stream.reset();
+
+	const auto backoff = std::chrono::seconds(1u << std::min(failures++, 8u));
+	retry_at = std::chrono::steady_clock::now() + std::min<std::chrono::seconds>(backoff, max_backoff);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "../metrics/stats.hpp"
+#include "../record/record.hpp"
+#include "../spool/spool.hpp"
+#include "../stream/streamclient.hpp"
+#include "../udp/retransmit.hpp"
+#include "../udp/udpclient.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/*
+ * One receiver of records with its own transport, format, batching, spool and
+ * failure state. A destination that keeps failing is only retried after an
+ * exponential backoff, so it does not hold up the others.
+ *
+ * A batch is its records one per line, as newline-delimited JSON or influx
+ * line protocol; streams end every batch with a newline too. Over UDP a batch
+ * goes out early rather than grow past max_datagram, a larger record alone.
+ */
+class destination {
+ public:
+	enum class transport { udp, tcp, local };
+
+	struct config {
+		transport kind = transport::udp;
+		// socket path for local
+		std::string host;
+		ushort port = 0;
+		::format encoding = ::format::json;
+		uint batch = 1;
+		// a partial batch older than that goes out anyway, zero waits for it to fill
+		std::chrono::milliseconds batch_age{0};
+		std::string spool;
+		size_t spool_size = 4 << 20;
+		uint spool_rate = 10;
+		size_t window = 0;
+
+		// [udp://|tcp://]host:port or unix://path, then [?format=json|influx][&batch=N][&spool=file][&nack=window], nack over udp only;
+		// unset keys are taken from defaults
+		[[nodiscard]] static config parse(std::string_view spec, const config& defaults);
+	};
+
+	explicit destination(config);
+
+	// sends what is batched and keeps what the stream did not get out in the spool
+	~destination();
+
+	[[nodiscard]] ::format encoding() const;
+
+	// queues encoded record and sends the batch once it is full
+	void push(uint64_t seq, std::string_view record);
+
+	// sends a partial batch that has reached batch_age
+	void tick(std::chrono::steady_clock::time_point now);
+
+	// resends records the receiver asked for
+	void serve_nacks();
+
+	[[nodiscard]] const sink_stats& statistics() const;
+
+	// fits into an Ethernet frame with IPv6 and UDP headers
+	static constexpr size_t max_datagram = 1400;
+
+ private:
+	config cfg;
+	sink_stats st;
+
+	std::optional<udpclient> client;
+	std::optional<streamclient> stream;
+	std::optional<spool> backlog;
+	std::optional<retransmit> window;
+
+	std::string batch;
+	uint batched;
+	std::chrono::steady_clock::time_point batch_started;
+
+	uint failures;
+	std::chrono::steady_clock::time_point retry_at;
+
+	// records of the stream counted as sent
+	uint64_t delivered = 0;
+	// the front of the spool went out in part
+	bool spooled_in_flight = false;
+
+	bool connect();
+
+	// false to keep data for later, a record that can never be sent is dropped
+	bool send(std::string_view data);
+
+	void cork(bool);
+
+	// into the spool, dropped if it can't take it
+	void keep(std::string_view data);
+
+	// sends the batch, or spools it
+	void flush();
+
+	void replay_spool();
+
+	// writes what the stream kept back, false while it still has some
+	bool drain();
+
+	void count_delivered();
+
+	// records the stream did not get out go back into the spool
+	void take_back();
+
+	void fail(std::string_view what, const std::exception& e);
+};
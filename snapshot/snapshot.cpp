@@ -0,0 +1,50 @@
+#include "snapshot.hpp"
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+template <typename Clock>
+int64_t ms(typename Clock::time_point t) {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(t.time_since_epoch()).count();
+}
+};  // namespace
+
+snapshot::acquisition snapshot::acquisition::now() {
+	return {std::chrono::steady_clock::now(), std::chrono::system_clock::now()};
+}
+
+void snapshot::clear() {
+	count = 0;
+}
+
+void snapshot::add(std::string_view sensor, const acquisition& at) {
+	const auto* names = std::find_if(std::begin(sensors), std::end(sensors), [sensor](const keys& k) { return k.sensor == sensor; });
+	if (names == std::end(sensors))
+		throw std::runtime_error(fmt::format("Unknown sensor '{}'", sensor));
+
+	// a sensor read twice, e.g. retried, keeps its latest reading
+	auto it = std::find_if(entries.begin(), entries.begin() + count, [names](const entry& e) { return e.names == names; });
+	if (it == entries.begin() + count)
+		++count;
+	*it = {names, at};
+}
+
+void snapshot::emit(record& rec, const acquisition& report) const {
+	rec.add("ts", ms<std::chrono::system_clock>(report.realtime));
+
+	if (!count)
+		return;
+
+	auto [oldest, newest] = std::minmax_element(entries.begin(), entries.begin() + count, [](const entry& a, const entry& b) { return a.at.monotonic < b.at.monotonic; });
+	rec.add("skew_ms", std::chrono::duration_cast<std::chrono::milliseconds>(newest->at.monotonic - oldest->at.monotonic).count());
+
+	for (size_t i = 0; i < count; ++i) {
+		const auto& e = entries[i];
+		rec.add(e.names->ts, ms<std::chrono::system_clock>(e.at.realtime));
+		rec.add(e.names->mono, ms<std::chrono::steady_clock>(e.at.monotonic));
+		rec.add(e.names->age, std::chrono::duration_cast<std::chrono::milliseconds>(report.monotonic - e.at.monotonic).count());
+	}
+}
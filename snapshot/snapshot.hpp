@@ -0,0 +1,51 @@
+#pragma once
+
+#include "../record/record.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <string_view>
+
+/*
+ * When each reading of a record was taken. A record gets ts, the unix ms it
+ * is reported at, and skew_ms, the spread of its readings. Every reading gets
+ * <sensor>_ts in unix ms, <sensor>_mono in ms of the monotonic clock, which
+ * does not jump with the wall clock, and <sensor>_age_ms before ts.
+ */
+class snapshot {
+ public:
+	struct acquisition {
+		std::chrono::steady_clock::time_point monotonic;
+		std::chrono::system_clock::time_point realtime;
+
+		static acquisition now();
+	};
+
+	void clear();
+
+	// one of s8, sds011, bme280 or bme680
+	void add(std::string_view sensor, const acquisition&);
+
+	void emit(record&, const acquisition& report) const;
+
+ private:
+	struct keys {
+		std::string_view sensor, ts, mono, age;
+	};
+
+	static constexpr keys sensors[] = {
+	    {"s8", "s8_ts", "s8_mono", "s8_age_ms"},
+	    {"sds011", "sds011_ts", "sds011_mono", "sds011_age_ms"},
+	    {"bme280", "bme280_ts", "bme280_mono", "bme280_age_ms"},
+	    {"bme680", "bme680_ts", "bme680_mono", "bme680_age_ms"},
+	};
+
+	struct entry {
+		const keys* names;
+		acquisition at;
+	};
+
+	std::array<entry, std::size(sensors)> entries;
+	size_t count = 0;
+};
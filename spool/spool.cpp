@@ -0,0 +1,177 @@
+#include "spool.hpp"
+#include "../logger/logger.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+#include <cstring>
+#include <stdexcept>
+
+/*
+ * The first page holds the header, records follow it. Positions are logical
+ * offsets that only grow, the physical offset is position modulo capacity.
+ * A record never wraps: if it does not fit before the end of the file the rest
+ * of the lap is skipped.
+ */
+struct spool::header {
+	uint64_t magic;
+	uint64_t capacity;
+	uint64_t read;
+	uint64_t write;
+	uint64_t records;
+	uint64_t dropped;
+};
+
+namespace {
+constexpr uint64_t magic = 0x314c4f4f50535241;  // "ARSPOOL1"
+constexpr size_t header_size = 4096;
+constexpr uint32_t padding = UINT32_MAX;
+
+constexpr size_t align(size_t size) {
+	return (size + 7) & ~size_t{7};
+}
+
+constexpr size_t entry_size(size_t record) {
+	return align(sizeof(uint32_t) + record);
+}
+};  // namespace
+
+spool::spool(const std::string& path, size_t size) : fh{open(path.c_str(), O_RDWR | O_CREAT, 0644)}, length{size & ~(header_size - 1)}, base{nullptr} {
+	if (fh < 0)
+		throw std::runtime_error(fmt::format("Failed to open '{}': {}", path, strerror(errno)));
+
+	try {
+		if (length < 2 * header_size)
+			throw std::runtime_error(fmt::format("Spool size should be at least {} bytes", 2 * header_size));
+
+		struct stat st;
+		if (fstat(fh, &st) < 0)
+			throw std::runtime_error(fmt::format("Failed to stat '{}': {}", path, strerror(errno)));
+
+		if (static_cast<size_t>(st.st_size) != length && ftruncate(fh, length) < 0)
+			throw std::runtime_error(fmt::format("Failed to resize '{}': {}", path, strerror(errno)));
+
+		if (void* addr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fh, 0); addr != MAP_FAILED)
+			base = static_cast<uint8_t*>(addr);
+		else
+			throw std::runtime_error(fmt::format("Failed to mmap '{}': {}", path, strerror(errno)));
+
+		// the whole file is walked front to back, tell the kernel to read ahead and drop behind
+		madvise(base, length, MADV_SEQUENTIAL);
+
+		auto& h = head();
+		const uint64_t capacity = length - header_size;
+		if (h.magic != magic || h.capacity != capacity || h.read > h.write || h.write - h.read > capacity) {
+			if (h.magic == magic)
+				logger::print(logger::warning, "Spool '{}' is inconsistent, starting over", path);
+			h = {.magic = magic, .capacity = capacity, .read = 0, .write = 0, .records = 0, .dropped = 0};
+		}
+	} catch (...) {
+		if (base)
+			munmap(base, length);
+		close(fh);
+		throw;
+	}
+}
+
+spool::spool(spool&& o) : fh{o.fh}, length{o.length}, base{o.base} {
+	o.fh = 0;
+	o.base = nullptr;
+}
+
+spool::~spool() {
+	if (base) {
+		msync(base, length, MS_SYNC);
+		munmap(base, length);
+	}
+
+	if (fh)
+		close(fh);
+}
+
+spool::header& spool::head() const {
+	return *reinterpret_cast<header*>(base);
+}
+
+uint8_t* spool::data() const {
+	return base + header_size;
+}
+
+uint64_t spool::first() const {
+	auto& h = head();
+	if (!h.records)
+		throw std::runtime_error("Spool is empty");
+
+	uint32_t size = padding;
+	if (const uint64_t left = h.capacity - h.read % h.capacity; left >= sizeof(uint32_t))
+		memcpy(&size, data() + h.read % h.capacity, sizeof(size));
+	else
+		return h.read + left;
+
+	return size == padding ? h.read + (h.capacity - h.read % h.capacity) : h.read;
+}
+
+void spool::push(std::string_view record) {
+	auto& h = head();
+	const size_t needed = entry_size(record.size());
+
+	if (needed > h.capacity / 2)
+		throw std::runtime_error(fmt::format("Record of {} bytes does not fit into spool", record.size()));
+
+	uint64_t skip;
+	for (;;) {
+		const uint64_t left = h.capacity - h.write % h.capacity;
+		skip = left < needed ? left : 0;
+		if (h.write + skip + needed - h.read <= h.capacity)
+			break;
+
+		pop();
+		++h.dropped;
+	}
+
+	if (skip) {
+		if (skip >= sizeof(uint32_t))
+			memcpy(data() + h.write % h.capacity, &padding, sizeof(uint32_t));
+		h.write += skip;
+	}
+
+	uint8_t* entry = data() + h.write % h.capacity;
+	const auto size = static_cast<uint32_t>(record.size());
+	memcpy(entry, &size, sizeof(size));
+	memcpy(entry + sizeof(size), record.data(), record.size());
+
+	h.write += needed;
+	++h.records;
+}
+
+bool spool::empty() const {
+	return !head().records;
+}
+
+std::string_view spool::front() const {
+	const uint8_t* entry = data() + first() % head().capacity;
+	uint32_t size;
+	memcpy(&size, entry, sizeof(size));
+
+	return {reinterpret_cast<const char*>(entry + sizeof(size)), size};
+}
+
+void spool::pop() {
+	auto& h = head();
+	const uint64_t pos = first();
+	uint32_t size;
+	memcpy(&size, data() + pos % h.capacity, sizeof(size));
+
+	h.read = --h.records ? pos + entry_size(size) : h.write;
+}
+
+uint64_t spool::size() const {
+	return head().records;
+}
+
+uint64_t spool::dropped() const {
+	return head().dropped;
+}
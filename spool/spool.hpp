@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/*
+ * Bounded FIFO of records kept in a memory-mapped file, so records survive
+ * restarts. Records are appended strictly sequentially around a ring; when the
+ * file is full the oldest records are dropped to make room.
+ */
+class spool {
+ public:
+	explicit spool(const std::string& path, size_t size);
+	explicit spool(spool&&);
+
+	~spool();
+
+	void push(std::string_view record);
+
+	[[nodiscard]] bool empty() const;
+
+	[[nodiscard]] std::string_view front() const;
+
+	void pop();
+
+	[[nodiscard]] uint64_t size() const;
+
+	[[nodiscard]] uint64_t dropped() const;
+
+ private:
+	struct header;
+
+	int fh;
+	size_t length;
+	uint8_t* base;
+
+	header& head() const;
+
+	uint64_t first() const;
+
+	uint8_t* data() const;
+};
@@ -0,0 +1,187 @@
+#include "streamclient.hpp"
+
+#include <fmt/core.h>
+#include <exception>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace {
+// a receiver that fell this far behind is considered gone
+constexpr size_t max_pending = 1 << 20;
+};  // namespace
+
+streamclient::streamclient() : fh{0}, tcp{false} {}
+
+streamclient::streamclient(streamclient&& o) : fh{o.fh}, tcp{o.tcp}, pending{std::move(o.pending)}, written{o.written}, lines{o.lines} {
+	o.fh = 0;
+}
+
+streamclient::~streamclient() {
+	if (fh)
+		close(fh);
+}
+
+void streamclient::connect(const std::string& host, ushort port) {
+	if (fh)
+		throw std::runtime_error("Socket is already open");
+
+	addrinfo hints, *addrs;
+	memset(&hints, 0, sizeof(hints));
+
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addrs))
+		throw std::runtime_error(fmt::format("Failed to get addr info for '{}': {}", host, strerror(errno)));
+
+	int error = 0;
+	for (auto addr = addrs; addr; addr = addr->ai_next) {
+		if (fh = socket(addr->ai_family, addr->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, addr->ai_protocol); fh < 0) {
+			fh = 0;
+			continue;
+		}
+
+		// non-blocking connect, the first writes just queue up until it completes
+		if (!::connect(fh, addr->ai_addr, addr->ai_addrlen) || errno == EINPROGRESS)
+			break;
+
+		error = errno;
+		close(fh);
+		fh = 0;
+	}
+	freeaddrinfo(addrs);
+
+	if (!fh)
+		throw std::runtime_error(fmt::format("Failed to connect to '{}:{}': {}", host, port, strerror(error)));
+
+	tcp = true;
+}
+
+void streamclient::connect(const std::string& path) {
+	if (fh)
+		throw std::runtime_error("Socket is already open");
+
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path))
+		throw std::runtime_error(fmt::format("Socket path '{}' is too long", path));
+	memcpy(addr.sun_path, path.c_str(), path.size());
+
+	if (fh = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0); fh < 0) {
+		fh = 0;
+		throw std::runtime_error(fmt::format("Failed to create socket: {}", strerror(errno)));
+	}
+
+	if (::connect(fh, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 && errno != EINPROGRESS) {
+		const int error = errno;
+		close(fh);
+		fh = 0;
+		throw std::runtime_error(fmt::format("Failed to connect to '{}': {}", path, strerror(error)));
+	}
+
+	tcp = false;
+}
+
+void streamclient::cork(bool on) {
+	if (!tcp)
+		return;
+
+	int value = on;
+	if (setsockopt(fh, IPPROTO_TCP, TCP_CORK, &value, sizeof(value)) < 0)
+		throw std::runtime_error(fmt::format("Failed to set TCP_CORK: {}", strerror(errno)));
+}
+
+void streamclient::send(std::string_view data) {
+	static char newline = '\n';
+
+	// leftovers, record and separator leave in one syscall
+	const size_t queued = pending.size() - written;
+	iovec iov[3] = {
+	    {.iov_base = pending.data() + written, .iov_len = queued},
+	    {.iov_base = const_cast<char*>(data.data()), .iov_len = data.size()},
+	    {.iov_base = &newline, .iov_len = 1},
+	};
+	msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = std::extent_v<decltype(iov)>;
+
+	long len = sendmsg(fh, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+	if (len < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOTCONN)
+			throw std::runtime_error(fmt::format("Failed to send message: {}", strerror(errno)));
+		len = 0;
+	}
+
+	const auto sent = static_cast<size_t>(len);
+	if (sent < queued) {
+		advance(sent);
+		if (pending.size() - written + data.size() + 1 > max_pending)
+			throw std::runtime_error(fmt::format("Receiver is not reading, {} bytes pending", pending.size() - written + data.size() + 1));
+		pending.append(data);
+		pending += newline;
+		return;
+	}
+
+	advance(queued);
+	const size_t rest = sent - queued;
+	if (rest > data.size()) {
+		lines += std::count(data.begin(), data.end(), '\n') + 1;
+		return;
+	}
+	pending.assign(data);
+	pending += newline;
+	advance(rest);
+}
+
+void streamclient::flush() {
+	if (!backed_up())
+		return;
+
+	long len = ::send(fh, pending.data() + written, pending.size() - written, MSG_NOSIGNAL | MSG_DONTWAIT);
+	if (len < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOTCONN)
+			throw std::runtime_error(fmt::format("Failed to send message: {}", strerror(errno)));
+		len = 0;
+	}
+	advance(static_cast<size_t>(len));
+}
+
+bool streamclient::backed_up() const {
+	return !pending.empty();
+}
+
+uint64_t streamclient::delivered() const {
+	return lines;
+}
+
+std::string streamclient::take_pending() {
+	std::string result = std::move(pending);
+	pending.clear();
+	written = 0;
+	return result;
+}
+
+void streamclient::advance(size_t bytes) {
+	const auto begin = pending.begin() + written;
+	lines += std::count(begin, begin + bytes, '\n');
+	written += bytes;
+
+	// records that are out entirely are forgotten, the rest is kept whole
+	if (const auto end = written ? pending.rfind('\n', written - 1) : std::string::npos; end != std::string::npos) {
+		pending.erase(0, end + 1);
+		written -= end + 1;
+	}
+}
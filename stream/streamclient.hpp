@@ -0,0 +1,54 @@
+#pragma once
+
+#include <netinet/in.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/*
+ * Persistent SOCK_STREAM connection over TCP or a Unix socket. Records are
+ * newline separated. Writes never block: whatever the socket does not take is
+ * kept and goes out first with the next write. A record only counts as
+ * delivered once the socket took all of it, the ones it did not can be taken
+ * back whole, so that they are sent again over the next connection.
+ */
+class streamclient {
+ public:
+	explicit streamclient();
+	explicit streamclient(streamclient&&);
+
+	~streamclient();
+
+	void connect(const std::string&, ushort);
+
+	void connect(const std::string& path);
+
+	// holds back partial segments until uncorked, no-op for Unix sockets
+	void cork(bool);
+
+	// throws if the receiver fell too far behind, the record is then not kept
+	void send(std::string_view);
+
+	// writes what is kept, if the socket takes it
+	void flush();
+
+	// some record was not taken in full yet
+	[[nodiscard]] bool backed_up() const;
+
+	// records the socket took in full so far
+	[[nodiscard]] uint64_t delivered() const;
+
+	// records not taken in full, newline terminated, the first one from its start
+	[[nodiscard]] std::string take_pending();
+
+ private:
+	int fh;
+	bool tcp;
+	// whole records, of which the first written bytes are out already
+	std::string pending;
+	size_t written = 0;
+	uint64_t lines = 0;
+
+	void advance(size_t bytes);
+};
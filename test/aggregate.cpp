@@ -0,0 +1,81 @@
+#include "../aggregate/aggregate.hpp"
+
+#include <fmt/format.h>
+
+#include <cmath>
+#include <vector>
+
+namespace {
+int near(const char* name, double got, double expected, double tolerance) {
+	if (std::abs(got - expected) <= tolerance)
+		return 0;
+	fmt::print(stderr, "{}: got {}, expected {} within {}\n", name, got, expected, tolerance);
+	return 1;
+}
+
+// up to exact_samples the nearest rank, whatever the order
+int exact() {
+	p2_quantile q{0.95};
+	int result = near("empty", q.get(), 0, 0);
+	for (int i = 20; i > 0; --i)
+		q.add(i);
+	result |= near("20 samples", q.get(), 19, 0);
+
+	q.clear();
+	q.add(7);
+	return result | near("after clear", q.get(), 7, 0);
+}
+
+// a permutation of 0 to 9999, and an exponential distribution by its quantile function
+int estimate() {
+	p2_quantile p95{0.95};
+	p2_quantile median{0.5};
+	for (int i = 0; i < 10000; ++i) {
+		p95.add(i * 7919 % 10000);
+		median.add(i * 7919 % 10000);
+	}
+	int result = near("uniform p95", p95.get(), 9500, 100) | near("uniform median", median.get(), 5000, 100);
+
+	p2_quantile skewed{0.95};
+	for (int i = 0; i < 10000; ++i)
+		skewed.add(-std::log(1 - (i * 7919 % 10000 + 0.5) / 10000));
+	return result | near("exponential p95", skewed.get(), -std::log(0.05), 0.1);
+}
+
+// every statistic of a window, and nothing for a window without samples
+int window() {
+	aggregator a;
+	for (int i = 0; i < 20; ++i)
+		a.add("co2", 400 + i);
+
+	record rec;
+	a.emit(rec);
+	const struct {
+		const char* key;
+		double expected;
+	} fields[] = {{"co2_min", 400}, {"co2_max", 419}, {"co2_mean", 409.5}, {"co2_std", std::sqrt(35.0)}, {"co2_p95", 418}};
+
+	int result = 0;
+	for (const auto& f : fields) {
+		const auto* got = rec.find(f.key);
+		if (!got) {
+			fmt::print(stderr, "window: {} is missing\n", f.key);
+			result = 1;
+			continue;
+		}
+		result |= near(f.key, std::get<double>(got->val), f.expected, 1e-9);
+	}
+
+	rec.clear();
+	a.emit(rec);
+	if (!rec.fields.empty()) {
+		fmt::print(stderr, "window: {} fields of an empty window\n", rec.fields.size());
+		result = 1;
+	}
+	return result;
+}
+};  // namespace
+
+int main() {
+	return exact() | estimate() | window();
+}
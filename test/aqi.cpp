@@ -0,0 +1,98 @@
+#include "../aqi/aqi.hpp"
+
+#include <fmt/format.h>
+
+#include <optional>
+
+namespace {
+using namespace std::chrono_literals;
+
+// both ends of every category, rounding within one, and beyond the scale
+int breakpoints() {
+	struct {
+		aqi::pollutant p;
+		uint64_t deca;
+		int64_t expected;
+	} cases[] = {
+	    {aqi::pollutant::pm25, 0, 0},     {aqi::pollutant::pm25, 90, 50},    {aqi::pollutant::pm25, 91, 51},
+	    {aqi::pollutant::pm25, 350, 99},  {aqi::pollutant::pm25, 354, 100},  {aqi::pollutant::pm25, 355, 101},
+	    {aqi::pollutant::pm25, 554, 150}, {aqi::pollutant::pm25, 555, 151},  {aqi::pollutant::pm25, 1254, 200},
+	    {aqi::pollutant::pm25, 1255, 201}, {aqi::pollutant::pm25, 2254, 300}, {aqi::pollutant::pm25, 2255, 301},
+	    {aqi::pollutant::pm25, 3254, 500}, {aqi::pollutant::pm25, 9999, 500}, {aqi::pollutant::pm10, 0, 0},
+	    {aqi::pollutant::pm10, 540, 50},  {aqi::pollutant::pm10, 549, 50},   {aqi::pollutant::pm10, 550, 51},
+	    {aqi::pollutant::pm10, 1000, 73}, {aqi::pollutant::pm10, 1540, 100}, {aqi::pollutant::pm10, 6040, 500},
+	    {aqi::pollutant::pm10, 9999, 500},
+	};
+
+	int result = 0;
+	for (const auto& c : cases) {
+		if (const auto i = aqi::index(c.p, c.deca); i != c.expected) {
+			fmt::print(stderr, "breakpoints: {} deca of {} is {}, expected {}\n", c.deca,
+			           c.p == aqi::pollutant::pm25 ? "PM2.5" : "PM10", i, c.expected);
+			result = 1;
+		}
+	}
+	return result;
+}
+
+int expect(const char* name, std::optional<uint64_t> got, std::optional<uint64_t> expected) {
+	if (got == expected)
+		return 0;
+	fmt::print(stderr, "{}: got {}, expected {}\n", name, got ? fmt::to_string(*got) : "none",
+	           expected ? fmt::to_string(*expected) : "none");
+	return 1;
+}
+
+// hour averages of 80, 100 and 400, newest weighted most, the weight not below one half
+int nowcast() {
+	const auto start = aqi::clock::time_point{} + 1000h;
+	aqi::hourly h;
+	h.add(80, start);
+	h.add(100, start + 1h);
+	int result = expect("nowcast of one hour", h.nowcast(), std::nullopt);
+
+	// (100 + 0.8 * 80) / 1.8
+	h.add(400, start + 2h);
+	result |= expect("nowcast of a steady rise", h.nowcast(), 91);
+
+	// (400 + 0.5 * 100 + 0.25 * 80) / 1.75
+	h.add(400, start + 3h);
+	return result | expect("nowcast of a jump", h.nowcast(), 268);
+}
+
+// 2 of the last 3 hours are needed, missing hours are skipped
+int nowcast_gaps() {
+	const auto start = aqi::clock::time_point{} + 1000h;
+	aqi::hourly h;
+	h.add(100, start);
+	h.add(100, start + 1h);
+	h.add(100, start + 2h);
+	int result = expect("nowcast of two hours", h.nowcast(), 100);
+
+	h.add(300, start + 4h);
+	result |= expect("nowcast after a missing hour", h.nowcast(), 100);
+
+	h.add(300, start + 7h);
+	return result | expect("nowcast of one of three hours", h.nowcast(), std::nullopt);
+}
+
+// 18 of 24 hours make a day, samples of an hour are averaged
+int day() {
+	const auto start = aqi::clock::time_point{} + 1000h;
+	aqi::hourly h;
+	for (int i = 0; i < 17; ++i) {
+		h.add(40, start + i * 1h);
+		h.add(61, start + i * 1h + 30min);
+	}
+	h.add(50, start + 17h);
+	int result = expect("day of 17 hours", h.day(), std::nullopt);
+
+	h.add(50, start + 18h);
+	// (17 * 50.5 + 50) / 18
+	return result | expect("day of 18 hours", h.day(), 50);
+}
+};  // namespace
+
+int main() {
+	return breakpoints() | nowcast() | nowcast_gaps() | day();
+}
@@ -0,0 +1,74 @@
+#include "../calibration/calibration.hpp"
+
+#include <fmt/format.h>
+
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+calibration parse(const char* text) {
+	std::istringstream stream{text};
+	return calibration::parse(stream, "test");
+}
+
+int expect(const char* name, const calibration& cal, uint64_t co2, uint64_t expected) {
+	s8::data data{co2};
+	cal.apply(data);
+	if (data.co2 == expected)
+		return 0;
+	fmt::print(stderr, "{}: {} became {}, expected {}\n", name, co2, data.co2, expected);
+	return 1;
+}
+
+// gains in 16.16 fixed point round to nearest, half up
+int gains() {
+	const auto cal = parse("s8 co2 gain 0.87\n");
+	const auto half = parse("s8 co2 gain 0.5\n");
+	const auto fine = parse("s8 co2 gain 1.0001\n");
+	return expect("gain", cal, 1000, 870) | expect("gain", cal, 0, 0) | expect("half gain", half, 3, 2) |
+	       expect("half gain", half, 4, 2) | expect("fine gain", fine, 10000, 10001) |
+	       expect("fine gain", fine, 4000, 4000);
+}
+
+// results below zero are clamped, after every step has been applied
+int clamping() {
+	const auto offset = parse("s8 co2 offset -50\n");
+	const auto negative = parse("s8 co2 gain -1\n");
+	const auto back = parse("s8 co2 offset -50\ns8 co2 offset 30\n");
+	return expect("offset", offset, 80, 30) | expect("offset below zero", offset, 30, 0) |
+	       expect("negative gain", negative, 10, 0) | expect("offsets", back, 30, 10);
+}
+
+// straight between points, the outer segments extended, clamped below zero
+int curve() {
+	const auto cal = parse("s8 co2 curve 100:50 200:250 300:300 # slopes 2 and 0.5\n");
+	return expect("curve point", cal, 100, 50) | expect("curve", cal, 150, 150) | expect("curve", cal, 250, 275) |
+	       expect("curve below", cal, 90, 30) | expect("curve below zero", cal, 50, 0) |
+	       expect("curve above", cal, 500, 400);
+}
+
+int fails(const char* text, const char* what) {
+	try {
+		parse(text);
+	} catch (const std::runtime_error& e) {
+		if (std::string_view{e.what()}.substr(0, 7) == "test:2:")
+			return 0;
+		fmt::print(stderr, "{}: unexpected error '{}'\n", what, e.what());
+		return 1;
+	}
+	fmt::print(stderr, "{}: was accepted\n", what);
+	return 1;
+}
+
+// errors name the line
+int errors() {
+	return fails("# comment\ns8 co3 offset 1\n", "unknown field") | fails("\ns8 co2 scale 2\n", "unknown step") |
+	       fails("\ns8 co2 gain\n", "missing gain") | fails("\ns8 co2 offset 1 2\n", "extra value") |
+	       fails("\nsds011 deca_pm10 curve 10:1 5:2\n", "decreasing curve") |
+	       fails("\nsds011 deca_pm10 curve 10:1\n", "single point");
+}
+};  // namespace
+
+int main() {
+	return gains() | clamping() | curve() | errors();
+}
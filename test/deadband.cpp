@@ -0,0 +1,108 @@
+#include "../deadband/deadband.hpp"
+
+#include <fmt/format.h>
+
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+using namespace std::chrono_literals;
+
+const std::vector<std::string> known{"co2", "deca_pm25", "gas"};
+
+record probe(std::optional<int64_t> co2, std::optional<int64_t> pm25, int64_t gas = 0) {
+	record rec;
+	if (co2)
+		rec.add("co2", *co2);
+	if (pm25)
+		rec.add("deca_pm25", *pm25);
+	rec.add("gas", gas);
+	return rec;
+}
+
+struct step {
+	record rec;
+	deadband::clock::duration at;
+	bool expected;
+	bool partial = false;
+};
+
+int run(const char* name, deadband band, const std::vector<step>& steps) {
+	const auto start = deadband::clock::time_point{} + 1000h;
+	for (size_t i = 0; i < steps.size(); ++i) {
+		const auto& s = steps[i];
+		if (band.moved(s.rec, start + s.at, s.partial) != s.expected) {
+			fmt::print(stderr, "{}: step {} {} reported, expected otherwise\n", name, i, s.expected ? "was not" : "was");
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// absolute and relative bands around the value last reported, not the last one seen
+int bands() {
+	return run("bands", deadband{{deadband::band::parse("co2=20"), deadband::band::parse("deca_pm25=10%")}, 1h, known},
+	           {
+	               {probe(600, 100), 0s, true},
+	               {probe(615, 105), 1s, false},
+	               {probe(620, 109), 2s, false},
+	               {probe(621, 100), 3s, true},
+	               {probe(621, 111), 4s, true},
+	               {probe(621, 100), 5s, false},
+	               {probe(621, 99), 6s, true},
+	               // fields without a band never cause a report
+	               {probe(621, 99, 5000), 7s, false},
+	           });
+}
+
+// the heartbeat sends unchanged readings again, and counts from the last report
+int heartbeat() {
+	return run("heartbeat", deadband{{deadband::band::parse("co2=20")}, 10s, known},
+	           {
+	               {probe(600, 0), 0s, true},
+	               {probe(600, 0), 9s, false},
+	               {probe(600, 0), 10s, true},
+	               {probe(650, 0), 15s, true},
+	               {probe(650, 0), 24s, false},
+	               {probe(650, 0), 25s, true},
+	           });
+}
+
+// a field appearing or vanishing is a change, unless a partial record just did not read it
+int missing() {
+	return run("missing", deadband{{deadband::band::parse("co2=20")}, 1h, known},
+	           {
+	               {probe(std::nullopt, 0), 0s, true},
+	               {probe(600, 0), 1s, true},
+	               {probe(std::nullopt, 0), 2s, true},
+	               {probe(600, 0), 3s, true},
+	               {probe(std::nullopt, 0), 4s, false, true},
+	               {probe(610, 0), 5s, false, true},
+	               {probe(630, 0), 6s, true, true},
+	           });
+}
+
+int errors() {
+	int result = 0;
+	for (const char* spec : {"co2", "=5", "co2=", "co2=-1", "co2=5%%", "co2=x"}) {
+		try {
+			static_cast<void>(deadband::band::parse(spec));
+			fmt::print(stderr, "errors: '{}' was accepted\n", spec);
+			result = 1;
+		} catch (const std::runtime_error&) {
+		}
+	}
+	try {
+		deadband{{deadband::band::parse("co3=5")}, 1h, known};
+		fmt::print(stderr, "errors: unknown field was accepted\n");
+		result = 1;
+	} catch (const std::runtime_error&) {
+	}
+	return result;
+}
+};  // namespace
+
+int main() {
+	return bands() | heartbeat() | missing() | errors();
+}
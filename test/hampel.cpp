@@ -0,0 +1,56 @@
+#include "../filter/hampel.hpp"
+
+#include <fmt/format.h>
+
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace {
+int run(const char* name, hampel filter, const std::vector<uint64_t>& in, const std::vector<uint64_t>& expected) {
+	for (size_t i = 0; i < in.size(); ++i) {
+		if (const auto out = filter.add(in[i]); out != expected[i]) {
+			fmt::print(stderr, "{}: sample {} of {} became {}, expected {}\n", name, i, in[i], out, expected[i]);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// spikes are replaced by the median, samples within the spread around it pass unchanged
+int outliers() {
+	return run("outliers", hampel{5, 3}, {80, 82, 81, 79, 80, 900, 83, 78, 0, 81},
+	           {80, 82, 81, 79, 80, 81, 83, 78, 80, 81});
+}
+
+// without a spread any other sample is an outlier, with one it passes
+int flat() {
+	return run("flat", hampel{3, 3}, {50, 50, 50, 51, 50, 50, 52, 51}, {50, 50, 50, 50, 50, 50, 50, 51});
+}
+
+// without a threshold the rolling median of the window, halves rounded up
+int median() {
+	return run("median", hampel{4, 0}, {10, 20, 30, 40, 100, 0, 35}, {10, 15, 20, 25, 35, 35, 38});
+}
+
+// values past the range of the sensor count as its top
+int range() {
+	return run("range", hampel{1, 0}, {hampel::levels - 1, hampel::levels, 100000}, {hampel::levels - 1, hampel::levels - 1, hampel::levels - 1});
+}
+
+int errors() {
+	for (const auto& [window, threshold] : {std::pair<size_t, double>{0, 3}, {65536, 3}, {5, -1}}) {
+		try {
+			hampel{window, threshold};
+			fmt::print(stderr, "errors: window {} and threshold {} were accepted\n", window, threshold);
+			return 1;
+		} catch (const std::runtime_error&) {
+		}
+	}
+	return 0;
+}
+};  // namespace
+
+int main() {
+	return outliers() | flat() | median() | range() | errors();
+}
@@ -0,0 +1,48 @@
+#include "../udp/retransmit.hpp"
+
+#include <fmt/format.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+// a window of 8 after records 0 to 19 were sent, so it holds 12 to 19
+int check(std::string_view nack, const std::vector<std::string_view>& expected) {
+	retransmit window{8};
+	std::vector<std::string> records;
+	for (int seq = 0; seq < 20; ++seq)
+		records.push_back(fmt::format("r{}", seq));
+	for (size_t seq = 0; seq < records.size(); ++seq)
+		window.add(seq, records[seq]);
+
+	const auto requested = window.requested(nack);
+	if (requested != expected) {
+		fmt::print(stderr, "'{}': got [{}], expected [{}]\n", nack, fmt::join(requested, ","), fmt::join(expected, ","));
+		return 1;
+	}
+	return 0;
+}
+
+int singles_and_ranges() {
+	return check("NACK 17", {"r17"}) | check("NACK 13 15-17", {"r13", "r15", "r16", "r17"}) |
+	       check("NACK 19-19", {"r19"});
+}
+
+// sequence numbers out of the window or not sent yet are skipped, and so is a reversed range
+int out_of_window() {
+	return check("NACK 3 11-13 19-25", {"r12", "r13", "r19"}) | check("NACK 20 11", {}) |
+	       check("NACK 0-18446744073709551615", {"r12", "r13", "r14", "r15", "r16", "r17", "r18", "r19"}) |
+	       check("NACK 17-15", {});
+}
+
+// anything else than a NACK is no request, garbage within one only costs its own token
+int malformed() {
+	return check("", {}) | check("NACK", {}) | check("nack 15", {}) | check("NACKS 15", {}) |
+	       check("NACK x 15 -3 16-y 17-", {"r15"}) | check("NACK  18", {"r18"});
+}
+};  // namespace
+
+int main() {
+	return singles_and_ranges() | out_of_window() | malformed();
+}
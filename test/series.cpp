@@ -0,0 +1,91 @@
+#include "../history/series.hpp"
+
+#include <fmt/format.h>
+
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace {
+bool same(double a, double b) {
+	return !memcmp(&a, &b, sizeof(a));
+}
+
+// every point comes back in order and bit for bit
+int round_trip(const char* name, const std::vector<std::pair<int64_t, double>>& points) {
+	series s;
+	for (const auto& [t, v] : points)
+		s.add(t, v);
+
+	std::vector<std::pair<int64_t, double>> decoded;
+	s.scan(INT64_MIN, INT64_MAX, [&](int64_t t, double v) { decoded.emplace_back(t, v); });
+
+	if (decoded.size() != points.size()) {
+		fmt::print(stderr, "{}: {} points decoded of {}\n", name, decoded.size(), points.size());
+		return 1;
+	}
+	for (size_t i = 0; i < points.size(); ++i) {
+		if (decoded[i].first != points[i].first || !same(decoded[i].second, points[i].second)) {
+			fmt::print(stderr, "{}: point {} is ({}, {}), expected ({}, {})\n", name, i, decoded[i].first,
+			           decoded[i].second, points[i].first, points[i].second);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// the delta of delta at both ends of every bucket and just outside them, each followed by its inverse
+int timestamps() {
+	const int64_t dods[] = {0,    1,     -1,   63,    -64,  64,    -65,   255,        -256,      256,
+	                        -257, 2047,  -2048, 2048, -2049, 1 << 20, -(1 << 20), INT32_MAX, -(int64_t{1} << 40)};
+	std::vector<std::pair<int64_t, double>> points;
+	int64_t t = 1000000;
+	const int64_t delta = int64_t{1} << 41;
+	points.emplace_back(t, 0);
+	points.emplace_back(t += delta, 1);
+	for (const auto dod : dods) {
+		points.emplace_back(t += delta + dod, 2);
+		points.emplace_back(t += delta, 3);
+	}
+	return round_trip("timestamps", points);
+}
+
+// repeated, slowly moving and wildly different values, over several blocks
+int values() {
+	std::vector<std::pair<int64_t, double>> points;
+	for (int i = 0; i < 20000; ++i) {
+		double v;
+		switch (i % 5) {
+			case 0: v = 21.5; break;
+			case 1: v = 21.5 + i * 1e-3; break;
+			case 2: v = -i * 1e10; break;
+			case 3: v = 1e-300 / (i + 1); break;
+			default: v = i; break;
+		}
+		points.emplace_back(i * 1000 + (i % 7), v);
+	}
+	return round_trip("values", points);
+}
+
+// a point from before the last one, as after the wall clock stepped back, is kept at the last one's time
+int clock_steps() {
+	series s;
+	s.add(5000, 1);
+	s.add(6000, 2);
+	s.add(3000, 3);
+	s.add(7000, 4);
+
+	std::vector<std::pair<int64_t, double>> decoded;
+	s.scan(6000, 6000, [&](int64_t t, double v) { decoded.emplace_back(t, v); });
+	const std::vector<std::pair<int64_t, double>> expected{{6000, 2}, {6000, 3}};
+	if (decoded != expected) {
+		fmt::print(stderr, "clock_steps: {} points at 6000, expected 2\n", decoded.size());
+		return 1;
+	}
+	return 0;
+}
+};  // namespace
+
+int main() {
+	return timestamps() | values() | clock_steps();
+}
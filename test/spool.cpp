@@ -0,0 +1,106 @@
+#include "../spool/spool.hpp"
+
+#include <fmt/format.h>
+
+#include <stdexcept>
+#include <string>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace {
+// the smallest spool, a page of header and a page of records
+constexpr size_t spool_size = 8192;
+
+std::string temporary() {
+	char path[] = "/tmp/air_test_spool_XXXXXX";
+	const int fh = mkstemp(path);
+	if (fh < 0)
+		throw std::runtime_error("Failed to create a temporary file");
+	close(fh);
+	return path;
+}
+
+// records of 100 bytes that tell their number
+std::string numbered(int i) {
+	return fmt::format("{:0<100}", fmt::format("record {} ", i));
+}
+
+// first in, first out, and the records survive a reopen
+int order() {
+	const auto path = temporary();
+	{
+		spool s{path, spool_size};
+		for (int i = 0; i < 3; ++i)
+			s.push(numbered(i));
+	}
+
+	spool s{path, spool_size};
+	int result = 0;
+	for (int i = 0; i < 3; ++i, s.pop()) {
+		if (s.empty() || s.front() != numbered(i)) {
+			fmt::print(stderr, "order: record {} is missing or wrong after reopen\n", i);
+			result = 1;
+			break;
+		}
+	}
+	if (!result && !s.empty()) {
+		fmt::print(stderr, "order: {} records left over\n", s.size());
+		result = 1;
+	}
+	unlink(path.c_str());
+	return result;
+}
+
+// many laps around the file: the oldest records make room, the rest stay in order up to the newest
+int wrap() {
+	const auto path = temporary();
+	spool s{path, spool_size};
+	constexpr int pushed = 1000;
+	for (int i = 0; i < pushed; ++i)
+		s.push(numbered(i));
+
+	int result = 0;
+	if (!s.dropped() || s.size() + s.dropped() != pushed) {
+		fmt::print(stderr, "wrap: {} kept and {} dropped of {}\n", s.size(), s.dropped(), pushed);
+		result = 1;
+	}
+	for (auto i = static_cast<int>(pushed - s.size()); !result && i < pushed; ++i, s.pop()) {
+		if (s.empty() || s.front() != numbered(i)) {
+			fmt::print(stderr, "wrap: record {} is missing or wrong\n", i);
+			result = 1;
+		}
+	}
+	if (!result && !s.empty()) {
+		fmt::print(stderr, "wrap: {} records left over\n", s.size());
+		result = 1;
+	}
+	unlink(path.c_str());
+	return result;
+}
+
+// a record larger than half the spool is refused, not written over the others
+int oversized() {
+	const auto path = temporary();
+	spool s{path, spool_size};
+	s.push(numbered(0));
+
+	int result = 0;
+	try {
+		s.push(std::string(spool_size / 2, 'x'));
+		fmt::print(stderr, "oversized: record was taken\n");
+		result = 1;
+	} catch (const std::runtime_error&) {
+		if (s.size() != 1 || s.front() != numbered(0)) {
+			fmt::print(stderr, "oversized: the record before was lost\n");
+			result = 1;
+		}
+	}
+	unlink(path.c_str());
+	return result;
+}
+};  // namespace
+
+int main() {
+	return order() | wrap() | oversized();
+}
@@ -0,0 +1,89 @@
+#include "tracer.hpp"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+uint32_t thread_id() {
+	thread_local const auto tid = static_cast<uint32_t>(syscall(SYS_gettid));
+	return tid;
+}
+};  // namespace
+
+tracer::tracer(const std::string& path, size_t size)
+    : file{fopen(path.c_str(), "w")}, epoch{std::chrono::steady_clock::now()}, ring{new event[size]}, capacity{size}, head{0}, tail{0}, dropped{0}, pid{getpid()} {
+	if (!file)
+		throw std::runtime_error(fmt::format("Failed to open '{}': {}", path, strerror(errno)));
+
+	if (!capacity) {
+		fclose(file);
+		throw std::runtime_error("Trace ring can't be empty");
+	}
+
+	for (size_t i = 0; i < capacity; ++i)
+		ring[i].ready.store(0, std::memory_order_relaxed);
+
+	// the array is left open until the end, viewers accept a truncated trace
+	fmt::print(file, "[\n{{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":{},\"args\":{{\"name\":\"air\"}}}},\n", pid);
+}
+
+tracer::~tracer() {
+	flush();
+	fmt::print(file, "{{\"name\":\"dropped\",\"ph\":\"i\",\"s\":\"g\",\"ts\":0,\"pid\":{},\"args\":{{\"events\":{}}}}}\n]\n", pid, dropped);
+	fclose(file);
+}
+
+void tracer::add(std::string_view name, std::string_view category, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+	const auto idx = head.fetch_add(1, std::memory_order_relaxed);
+	auto& e = ring[idx % capacity];
+
+	e.ready.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	e.name = name;
+	e.category = category;
+	e.start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch).count();
+	e.duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	e.tid = thread_id();
+	e.ready.store(idx + 1, std::memory_order_release);
+}
+
+void tracer::flush() {
+	const auto until = head.load(std::memory_order_acquire);
+
+	if (until - tail > capacity) {
+		dropped += until - tail - capacity;
+		tail = until - capacity;
+	}
+
+	for (; tail < until; ++tail) {
+		const auto& e = ring[tail % capacity];
+		if (e.ready.load(std::memory_order_acquire) != tail + 1) {
+			++dropped;
+			continue;
+		}
+
+		const auto name = e.name;
+		const auto category = e.category;
+		const auto start_ns = e.start_ns;
+		const auto duration_ns = e.duration_ns;
+		const auto tid = e.tid;
+
+		// a writer lapped us while copying
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (e.ready.load(std::memory_order_relaxed) != tail + 1) {
+			++dropped;
+			continue;
+		}
+
+		fmt::print(
+		    file, "{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":{},\"tid\":{}}},\n", name, category,
+		    start_ns / 1000.0, duration_ns / 1000.0, pid, tid);
+	}
+
+	fflush(file);
+}
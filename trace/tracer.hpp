@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/*
+ * Records spans into a lock-free ring and appends them to a file in Chrome
+ * trace-event format (chrome://tracing, ui.perfetto.dev). Names and categories
+ * are not copied, they have to outlive the next flush.
+ *
+ * Writers claim a slot with a single fetch_add and publish it with a release
+ * store; flush() skips slots that were overwritten before it got to them.
+ */
+class tracer {
+ public:
+	explicit tracer(const std::string& path, size_t capacity = 4096);
+	explicit tracer(tracer&&) = delete;
+
+	~tracer();
+
+	void add(std::string_view name, std::string_view category, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+	// writes everything recorded so far, from a single thread
+	void flush();
+
+	class span {
+	 public:
+		span(tracer* t, std::string_view n, std::string_view c) : owner{t}, name{n}, category{c} {
+			if (owner)
+				start = std::chrono::steady_clock::now();
+		}
+
+		span(const span&) = delete;
+
+		~span() {
+			if (owner)
+				owner->add(name, category, start, std::chrono::steady_clock::now());
+		}
+
+	 private:
+		tracer* owner;
+		std::string_view name;
+		std::string_view category;
+		std::chrono::steady_clock::time_point start;
+	};
+
+ private:
+	struct event {
+		std::atomic<uint64_t> ready;
+		std::string_view name;
+		std::string_view category;
+		int64_t start_ns;
+		int64_t duration_ns;
+		uint32_t tid;
+	};
+
+	FILE* file;
+	std::chrono::steady_clock::time_point epoch;
+	std::unique_ptr<event[]> ring;
+	size_t capacity;
+	std::atomic<uint64_t> head;
+	uint64_t tail;
+	uint64_t dropped;
+	int pid;
+};
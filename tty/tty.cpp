@@ -0,0 +1,154 @@
+#include "tty.hpp"
+#include "../capture/capture.hpp"
+#include "../logger/logger.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+void configure_interface(int fh, const tty::settings& s) {
+	termios tty;
+
+	if (tcgetattr(fh, &tty) < 0)
+		throw std::runtime_error(fmt::format("Failed to tcgetattr: {}", strerror(errno)));
+
+	cfsetospeed(&tty, s.speed);
+	cfsetispeed(&tty, s.speed);
+
+	tty.c_cflag |= (CLOCAL | CREAD); /* ignore modem controls */
+	tty.c_cflag &= ~CSIZE;
+	tty.c_cflag |= CS8;      /* 8-bit characters */
+	tty.c_cflag &= ~PARENB;  /* no parity bit */
+	tty.c_cflag &= ~CSTOPB;  /* only need 1 stop bit */
+	tty.c_cflag &= ~CRTSCTS; /* no hardware flowcontrol */
+
+	/* setup for non-canonical mode */
+	tty.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
+	tty.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+	tty.c_oflag &= ~OPOST;
+
+	/* fetch bytes as they become available */
+	tty.c_cc[VMIN] = s.min;
+	tty.c_cc[VTIME] = s.time;
+
+	if (tcsetattr(fh, TCSANOW, &tty) != 0)
+		throw std::runtime_error(fmt::format("Failed to tcsetattr: {}", strerror(errno)));
+}
+
+std::string_view bytes(const uint8_t* data, size_t size) {
+	return {reinterpret_cast<const char*>(data), size};
+}
+};  // namespace
+
+namespace tty {
+device::device(const std::string& path, const settings& s) : fh{::open(path.c_str(), O_RDWR | O_NOCTTY | O_SYNC)} {
+	if (fh < 0)
+		throw std::runtime_error(fmt::format("Failed to open '{}': {}", path, strerror(errno)));
+
+	try {
+		if (tcgetattr(fh, &tty_back) < 0)
+			throw std::runtime_error(fmt::format("Failed to tcgetattr: {}", strerror(errno)));
+
+		configure_interface(fh, s);
+
+		/* There is a problem with flushing buffers on a serial USB that can
+		 * not be solved. The only thing one can try is to flush any buffers
+		 * after some delay:
+		 *
+		 * https://bugzilla.kernel.org/show_bug.cgi?id=5730
+		 * https://stackoverflow.com/questions/13013387/clearing-the-serial-ports-buffer
+		 */
+		usleep(10000);
+		tcflush(fh, TCIOFLUSH);
+	} catch (...) {
+		close(fh);
+		throw;
+	}
+}
+
+device::~device() {
+	if (tcsetattr(fh, TCSANOW, &tty_back) < 0)
+		logger::print(logger::warning, "Failed to reset tcsetattr: {}", strerror(errno));
+
+	close(fh);
+}
+
+ssize_t device::write(const uint8_t* data, size_t size) {
+	return ::write(fh, data, size);
+}
+
+ssize_t device::read(uint8_t* data, size_t size) {
+	return ::read(fh, data, size);
+}
+
+recorder::recorder(std::unique_ptr<port> p, capture::writer& w, uint16_t c) : inner{std::move(p)}, out{w}, channel{c} {}
+
+ssize_t recorder::write(const uint8_t* data, size_t size) {
+	const auto result = inner->write(data, size);
+	const int error = errno;
+	out.add(channel, capture::op::write, result < 0 ? -error : result, data, size);
+	errno = error;
+	return result;
+}
+
+ssize_t recorder::read(uint8_t* data, size_t size) {
+	const auto result = inner->read(data, size);
+	const int error = errno;
+	out.add(channel, capture::op::read, result < 0 ? -error : result, data, std::max<ssize_t>(result, 0));
+	errno = error;
+	return result;
+}
+
+player::player(capture::reader& r, uint16_t c) : in{r}, channel{c} {}
+
+ssize_t player::write(const uint8_t* data, size_t size) {
+	const auto& e = in.next(channel, capture::op::write, bytes(data, size));
+	if (e.result < 0) {
+		errno = -e.result;
+		return -1;
+	}
+	return e.result;
+}
+
+ssize_t player::read(uint8_t* data, size_t size) {
+	const auto& e = in.next(channel, capture::op::read);
+	if (e.result < 0) {
+		errno = -e.result;
+		return -1;
+	}
+	const auto replayed = std::min(size, e.data.size());
+	memcpy(data, e.data.data(), replayed);
+	return replayed;
+}
+
+std::unique_ptr<port> open(const std::string& path, const settings& s) {
+	if (auto* replay = capture::reader::active) {
+		const auto channel = replay->channel(path);
+		if (const auto& e = replay->next(channel, capture::op::open); e.result < 0)
+			throw std::runtime_error(fmt::format("Failed to open '{}': {}", path, strerror(-e.result)));
+		return std::make_unique<player>(*replay, channel);
+	}
+
+	auto* record = capture::writer::active;
+	if (!record)
+		return std::make_unique<device>(path, s);
+
+	// failures are recorded too, a sensor that comes and goes replays the same way
+	const auto channel = record->channel(path);
+	try {
+		auto result = std::make_unique<device>(path, s);
+		record->add(channel, capture::op::open, 0, nullptr, 0);
+		return std::make_unique<recorder>(std::move(result), *record, channel);
+	} catch (...) {
+		record->add(channel, capture::op::open, -(errno ? errno : EIO), nullptr, 0);
+		throw;
+	}
+}
+};  // namespace tty
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <sys/types.h>
+#include <termios.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace capture {
+class writer;
+class reader;
+};  // namespace capture
+
+namespace tty {
+// byte stream to a serial sensor, with read(2) and write(2) semantics
+class port {
+ public:
+	virtual ~port() = default;
+
+	virtual ssize_t write(const uint8_t* data, size_t size) = 0;
+	virtual ssize_t read(uint8_t* data, size_t size) = 0;
+};
+
+struct settings {
+	speed_t speed;
+	// termios VMIN and VTIME of the raw mode
+	cc_t min;
+	cc_t time;
+};
+
+// serial device in raw mode, restored on destruction
+class device : public port {
+ public:
+	device(const std::string& path, const settings&);
+	device(const device&) = delete;
+
+	~device() override;
+
+	ssize_t write(const uint8_t* data, size_t size) override;
+	ssize_t read(uint8_t* data, size_t size) override;
+
+ private:
+	int fh;
+	termios tty_back;
+};
+
+// passes everything through and writes it to the capture
+class recorder : public port {
+ public:
+	recorder(std::unique_ptr<port>, capture::writer&, uint16_t channel);
+
+	ssize_t write(const uint8_t* data, size_t size) override;
+	ssize_t read(uint8_t* data, size_t size) override;
+
+ private:
+	std::unique_ptr<port> inner;
+	capture::writer& out;
+	uint16_t channel;
+};
+
+// answers from a capture instead of a device
+class player : public port {
+ public:
+	player(capture::reader&, uint16_t channel);
+
+	ssize_t write(const uint8_t* data, size_t size) override;
+	ssize_t read(uint8_t* data, size_t size) override;
+
+ private:
+	capture::reader& in;
+	uint16_t channel;
+};
+
+// device at path, or its recording while capture::reader::active, recorded while capture::writer::active
+[[nodiscard]] std::unique_ptr<port> open(const std::string& path, const settings&);
+};  // namespace tty
@@ -0,0 +1,66 @@
+#include "retransmit.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+
+namespace {
+constexpr std::string_view nack_prefix = "NACK ";
+};  // namespace
+
+retransmit::retransmit(size_t size) : slots(size), next{0} {
+	if (!size)
+		throw std::runtime_error("Retransmit window can't be empty");
+}
+
+void retransmit::add(uint64_t seq, std::string_view record) {
+	auto& slot = slots[seq % slots.size()];
+	slot.first = seq;
+	// assign keeps the slot's buffer, so the window stops allocating once warmed up
+	slot.second.assign(record);
+	next = seq + 1;
+}
+
+std::string_view retransmit::find(uint64_t seq) const {
+	if (seq >= next || next - seq > slots.size())
+		return {};
+
+	const auto& slot = slots[seq % slots.size()];
+	return slot.first == seq ? std::string_view{slot.second} : std::string_view{};
+}
+
+std::vector<std::string_view> retransmit::requested(std::string_view nack) const {
+	std::vector<std::string_view> result;
+
+	if (nack.substr(0, nack_prefix.size()) != nack_prefix)
+		return result;
+	nack.remove_prefix(nack_prefix.size());
+
+	while (!nack.empty()) {
+		const auto token = nack.substr(0, nack.find(' '));
+		nack.remove_prefix(std::min(nack.size(), token.size() + 1));
+
+		uint64_t first = 0, last = 0;
+		const auto dash = token.find('-');
+		const auto first_str = token.substr(0, dash);
+		if (std::from_chars(first_str.data(), first_str.data() + first_str.size(), first).ec != std::errc{})
+			continue;
+		last = first;
+		if (dash != std::string_view::npos) {
+			const auto last_str = token.substr(dash + 1);
+			if (std::from_chars(last_str.data(), last_str.data() + last_str.size(), last).ec != std::errc{})
+				continue;
+		}
+
+		// never walk further than the window reaches, whatever the range says
+		if (next > slots.size())
+			first = std::max(first, next - slots.size());
+		last = std::min(last, next ? next - 1 : 0);
+
+		for (auto seq = first; seq <= last && seq < next; ++seq)
+			if (auto record = find(seq); !record.empty())
+				result.push_back(record);
+	}
+
+	return result;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*
+ * Window of the last sent records, kept so that the receiver can ask for lost
+ * ones again. The receiver sends a NACK datagram back to the sender's socket:
+ *
+ *   NACK <seq>|<first>-<last> ...
+ *
+ * e.g. "NACK 17 20-23". Sequence numbers that already left the window are
+ * silently ignored.
+ */
+class retransmit {
+ public:
+	explicit retransmit(size_t size);
+
+	void add(uint64_t seq, std::string_view record);
+
+	// records requested by the datagram, empty if it is not a NACK
+	[[nodiscard]] std::vector<std::string_view> requested(std::string_view nack) const;
+
+ private:
+	std::vector<std::pair<uint64_t, std::string>> slots;
+	uint64_t next;
+
+	std::string_view find(uint64_t seq) const;
+};
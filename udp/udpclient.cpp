@@ -1,4 +1,5 @@
 #include "udpclient.hpp"
+#include "../errors/errors.hpp"
 
 #include <fmt/core.h>
 #include <exception>
@@ -47,8 +48,28 @@ void udpclient::connect(const std::string& host, ushort port) {
 	freeaddrinfo(addrs_save);
 }
 
-void udpclient::send(const std::string& data) {
-	if (long len = sendto(fh, data.c_str(), data.length(), MSG_CONFIRM, servaddr.get(), servaddr_size);
-	    len != static_cast<long>(data.length()))
+void udpclient::send(std::string_view data) {
+	if (long len = sendto(fh, data.data(), data.length(), MSG_CONFIRM | MSG_DONTWAIT, servaddr.get(), servaddr_size);
+	    len != static_cast<long>(data.length())) {
+		if (len < 0 && errno == EMSGSIZE)
+			throw message_size_error(fmt::format("Message of {} bytes does not fit into a datagram", data.length()));
 		throw std::runtime_error(fmt::format("Failed to send message, delivered only {}: {}", len, strerror(errno)));
+	}
+}
+
+std::string_view udpclient::receive(char* buffer, size_t size) {
+	sockaddr_storage from;
+	for (;;) {
+		socklen_t from_size = sizeof(from);
+		long len = recvfrom(fh, buffer, size, MSG_DONTWAIT, reinterpret_cast<sockaddr*>(&from), &from_size);
+		if (len < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return {};
+			throw std::runtime_error(fmt::format("Failed to receive message: {}", strerror(errno)));
+		}
+
+		// anybody can write to our port, only listen to the receiver
+		if (static_cast<int>(from_size) == servaddr_size && !memcmp(&from, servaddr.get(), servaddr_size))
+			return {buffer, static_cast<size_t>(len)};
+	}
 }
@@ -2,8 +2,9 @@
 
 #include <netinet/in.h>
 #include <cstddef>
-#include <string_view>
 #include <memory>
+#include <string>
+#include <string_view>
 
 class udpclient {
  public:
@@ -14,7 +15,10 @@ class udpclient {
 
 	void connect(const std::string&, ushort);
 
-	void send(const std::string&);
+	void send(std::string_view);
+
+	// next datagram the receiver sent back, empty if there is none; never blocks
+	[[nodiscard]] std::string_view receive(char* buffer, size_t size);
 
  private:
 	int fh;